@@ -1,26 +1,64 @@
 /* (c) Spencer Tinnin 2018 based off of code written by Martin Erzberger*/
 
 #include "Python.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <pthread.h>
+#include <time.h>
+#include <math.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#ifdef __linux__
+#include <linux/spi/spidev.h>
+#endif
 
 typedef uint8_t byte;
 
 static const byte BYTES_PER_LED = 4;
+static const byte START_FRAME_BYTES = 4; // 4 0-bytes tell the first pixel its color will be sent next
 static const byte MAX_BRIGHTNESS = 31; // Safeguard: Max. brightness that can be selected. 
 static const byte LED_START = 0b11100000; // Three "1" bits, followed by 5 brightness bits
 static const byte LED_BRIGHT_MASK = 0b0011111;
 static const byte RED = 0, GRN = 1, BLU = 2;
+#define PACE_INTERVALS 256 //how many frame intervals get_frame_stats() looks at
+#define LOCK_SEGMENTS 16 //how many pieces the leds are split into for locking when threaded is set
+#define GIL_RELEASE_LEDS 512 //drawing at least this many leds lets go of the GIL when threaded is set
+#define LEDS_PER_LINE 16 //leds in a 64 byte cache line, render pool slices are a multiple of this
+#define RENDER_MIN_LEDS 20000 //default for how many leds a job needs before the render pool splits it up
+enum {SHM_NONE, SHM_READ, SHM_WRITE}; //how a strip uses the shared memory frame from attach_shm()
 
 static PyObject *ErrorObject;
 
 PyDoc_STRVAR(apa102_module_doc,
 	"This module defines an object type that allows the user to control a string of APA102 pixels (also known as the Adafruit DotStar)\n"
 	"to create one use the following syntax:\n"
-	"APA102(num_led, spi_write, [global_brightness=31], [order=\"RGB\"])\n"
+	"APA102(num_led, spi_write, [global_brightness=31], [order=\"RGB\"], [legacy_list=False], [speed_hz=0], [chunk_size], [threaded=False])\n"
 		"\tnum_led -- how many leds you want to drive\n"
 		"\twrite_callback -- the function called to send data to the leds if set to None, show() will do nothing\n"
-			"\t\tthis was designed with spidev.write() in mind, but any function that takes in a list of numbers will work"
+			"\t\tthis was designed with spidev.writebytes() in mind, it is passed a read only memoryview of the whole frame\n"
+			"\t\tthe memoryview is only valid until write_callback returns, keeping a view of it makes show raise BufferError\n"
+			"\t\tit can also be a path to a spidev device (\"/dev/spidev0.0\") or an open file descriptor,\n"
+			"\t\tthen show() writes the frame itself without holding the GIL\n"
 		"\tglobal_brightness (optional) -- a number from 0 to 31 (inclusive) determining how bright the pixels show \n\t\tNote: a brightness of 0 will mean the pixels never turn on)\n"
 		"\torder (optional) -- the order that your strip takes the red, green, and blue values as a string\n"
+		"\tlegacy_list (optional) -- if True, write_callback is passed a list of numbers instead of a memoryview\n"
+		"\tspeed_hz (optional) -- the SPI clock used when writing to a spidev device, 0 keeps the device's setting\n"
+		"\tchunk_size (optional) -- the most bytes sent in one spidev message or write_callback call, longer frames are split up, 0 for no limit\n"
+			"\t\tspidev devices default to the driver's bufsiz (usually 4096), everything else to 0\n"
+		"\tthreaded (optional) -- if True, several threads can draw on the strip and call show() at the same time,\n"
+			"\t\tthreads drawing different parts of the strip don't wait for each other and large fills let go of the GIL\n"
+			"\t\tsetup calls (layers, gamma, async policy...) and writes through the buffer protocol still need to come from one thread\n"
+	"The object supports the buffer protocol: memoryview(strip) or numpy.asarray(strip) give a writable (num_led, 4) view\n"
+		"\tof the pixels as they are sent, column 0 is the brightness byte and order gives the columns of red, green, and blue\n"
 	"Public Functions:\n"
 		"\tset_pixel\n"
 		"\tset_pixel_rgb\n"
@@ -29,7 +67,40 @@ PyDoc_STRVAR(apa102_module_doc,
 		"\tset_range_rgb\n"
 		"\tset_all\n"
 		"\tset_all_rgb\n"
+		"\tset_pixels\n"
+		"\tset_pixels_at\n"
+		"\tget_pixels_at\n"
+		"\tset_pixels_hsv\n"
+		"\thsv_to_rgb\n"
+		"\tset_palette\n"
+		"\tset_indices\n"
+		"\trotate_palette\n"
+		"\tset_layout\n"
+		"\tblit\n"
 		"\tshow\n"
+		"\tshow_async\n"
+		"\twait\n"
+		"\tset_async_policy\n"
+		"\tset_render_threads\n"
+		"\tset_gamma\n"
+		"\tset_dimmer\n"
+		"\tadd_layer\n"
+		"\tselect_layer\n"
+		"\tset_layer\n"
+		"\tremove_layers\n"
+		"\tset_target_fps\n"
+		"\tpresent\n"
+		"\tget_frame_stats\n"
+		"\treset_frame_stats\n"
+		"\tenable_stats\n"
+		"\treset_stats\n"
+		"\trecord\n"
+		"\tstop_recording\n"
+		"\tplay\n"
+		"\tlisten\n"
+		"\tstop_listening\n"
+		"\tattach_shm\n"
+		"\tdetach_shm\n"
 		"\tclear_strip\n"
 		"\trotate\n"
 		"\tget_pixel_color_str\n"
@@ -37,18 +108,177 @@ PyDoc_STRVAR(apa102_module_doc,
 		"\tget_pixel_color\n"
 		"\tcombine_color\n"
 		"\twheel\n"
-		"\tdump_array"
+		"\tfill_rainbow\n"
+		"\tfill_gradient\n"
+		"\tchase\n"
+		"\ttwinkle\n"
+		"\tfade_to_black\n"
+		"\tdump_array\n"
+	"Timeline(num_led, [loop=False]) holds keyframes that are interpolated into an APA102 object, see help(Timeline)\n"
+	"Layout(width, height, ...) maps (x, y) on a matrix of panels to led numbers for blit, see help(Layout)\n"
 	"Variables (all are read only):\n"
 		"\tnum_led\n"
 		"\tglobal_brightness\n"
+		"\tstats\n"
 		"\torder\n"
 		"\twrite_callback\n"
+		"\tfd\n"
+		"\tchunk_size\n"
+		"\trender_threads\n"
+		"\tgamma\n"
+		"\tdimmer\n"
+		"\tlayer\n"
+		"\tlayout\n"
+		"\tnum_layers\n"
+		"\tpalette_size\n"
 		"\tMAX_BRIGHTNESS\n");
 
+//an extra pixel buffer drawn over the leds before they are sent, layer 0 is the frame's own leds
 typedef struct {
+	byte *leds;
+	Py_ssize_t head;
+	double opacity;
+	int mode;
+	uint16_t alpha_scale;
+} layer;
+
+struct apa102Object;
+//work split up by the set_render_threads() pool, each call does leds start to end (exclusive)
+typedef void (*render_fn)(struct apa102Object *self, const void *arg, Py_ssize_t start, Py_ssize_t end);
+
+typedef struct apa102Object {
 	PyObject_HEAD
 	PyObject *spi_write;
-	byte *leds;
+	byte *frame; //the whole frame as it is sent out: start frame, leds, then end frame
+	byte *leds; //points into frame, just past the start frame
+	Py_ssize_t frame_len;
+	int legacy_list;
+	int fd; //-1 unless show() writes the frame itself
+	int owns_fd; //set if the fd was opened from a path and has to be closed
+	int is_spidev;
+	uint32_t speed_hz;
+	Py_ssize_t chunk_size; //the most bytes sent in one spidev message or write_callback call, 0 for no limit
+	int transmitting; //set while show() is writing without the GIL
+	int exports; //how many buffers are looking at leds
+	int frame_exports; //how many buffers write_callback kept from the memoryviews it was given
+	Py_ssize_t shape[2];
+	Py_ssize_t strides[2];
+	//show_async() state, everything below async_lock is only touched while holding it
+	int async_running;
+	int async_stop;
+	int async_policy;
+	int async_depth;
+	pthread_t async_thread;
+	pthread_mutex_t async_lock;
+	pthread_cond_t async_cond;
+	byte *async_buffers;
+	byte **async_queue; //ring of async_depth frames waiting to be sent
+	byte **async_free; //buffers not in use
+	byte *async_sending; //the frame the worker is sending right now
+	int async_head;
+	int async_count;
+	int async_free_count;
+	int async_errno;
+	PyObject *async_error; //only touched with the GIL
+	//present() state, all times are CLOCK_MONOTONIC in ns
+	uint64_t pace_period;
+	uint64_t pace_deadline;
+	int pace_skip_late;
+	uint64_t pace_last_present;
+	uint64_t pace_frames;
+	uint64_t pace_late;
+	uint64_t pace_dropped;
+	uint64_t pace_intervals[PACE_INTERVALS];
+	int pace_interval_pos;
+	int pace_interval_count;
+	//leds that changed since the last frame was sent, nothing changed when dirty_start >= dirty_end
+	Py_ssize_t dirty_start;
+	Py_ssize_t dirty_end;
+	PyObject *frame_list; //the list passed to write_callback in legacy_list mode, reused between frames
+	//leds is a ring: led 0 is stored at index head, so rotate() only has to move head
+	Py_ssize_t head;
+	byte *wire; //frame_len bytes for when the frame has to be put together before it is sent
+	//gamma correction and dimming, lut is applied to every color as the frame is encoded
+	double gamma; //0 if a table was given
+	byte dimmer;
+	int lut_active; //set unless lut doesn't change anything
+	int hdr;
+	byte gamma_table[256];
+	uint16_t gamma_table16[256];
+	byte lut[256];
+	uint16_t lut16[256]; //for hdr
+	uint32_t random_state; //for twinkle
+	//record() state
+	FILE *rec_file;
+	byte *rec_prev; //the last recorded leds, in order from led 0
+	byte *rec_buf; //the frame being written
+	uint64_t rec_frames;
+	//layers, when there are any leds and head belong to the selected one and the others are kept in layers
+	layer *layers;
+	int num_layers; //0 until add_layer() is called, then including layer 0
+	int current_layer;
+	byte *composite; //the layers drawn together, in order from led 0
+	PyObject *layout; //the Layout blit() uses, or NULL
+	//listen() state, only touched with the GIL except for the settings the receiver thread reads
+	int net_running;
+	int net_fd;
+	int net_wake[2]; //a pipe written to when the receiver has to stop
+	pthread_t net_thread;
+	int net_protocol;
+	int net_universe;
+	int net_universe_size;
+	int net_universes;
+	int net_start;
+	int net_show;
+	uint64_t net_packets;
+	uint64_t net_frames;
+	PyObject *net_error;
+	//attach_shm() state
+	int shm_mode;
+	byte *shm; //the mapped segment, a shm_header and then the leds
+	size_t shm_len;
+	uint32_t shm_seq; //seq of the last frame read
+	PyObject *shm_name; //bytes, for shm_unlink
+	//indexed mode, the leds are looked up in palette when the frame is sent
+	byte *indices; //one per led, in order from led 0
+	uint32_t *palette; //NULL unless indexed, 256 entries stored like leds
+	int palette_len;
+	//counters for the stats attribute, only kept while stats_enabled is set
+	int stats_enabled; //only changed while holding async_lock too, so the worker can read it
+	uint64_t stat_frames;
+	uint64_t stat_bytes;
+	uint64_t stat_encode_ns;
+	uint64_t stat_write_ns;
+	uint64_t stat_latency_max;
+	uint64_t stat_latency_total;
+	uint64_t stat_set_calls;
+	//frames sent by the show_async() worker, only touched while holding async_lock
+	uint64_t stat_async_frames;
+	uint64_t stat_async_bytes;
+	uint64_t stat_async_write_ns;
+	//threaded=True locking: each segment lock covers lock_span leds in order from led 0, show_lock keeps one frame going out at a time
+	//nobody waits for the GIL while holding a segment lock, and show_lock is only waited for without the GIL
+	int threaded;
+	Py_ssize_t lock_span;
+	pthread_mutex_t segment_locks[LOCK_SEGMENTS];
+	pthread_mutex_t dirty_lock;
+	pthread_mutex_t show_lock;
+	//set_render_threads() pool, everything from render_job on is only touched while holding render_lock
+	int render_threads; //including the thread that hands out the work, 1 when there is no pool
+	Py_ssize_t render_min_leds;
+	pthread_t *render_pool;
+	pthread_mutex_t render_busy; //held while a job is running, only one can use the pool at a time
+	pthread_mutex_t render_lock;
+	pthread_cond_t render_cond;
+	pthread_cond_t render_done;
+	render_fn render_job;
+	const void *render_arg;
+	Py_ssize_t render_start;
+	Py_ssize_t render_end;
+	Py_ssize_t render_slice;
+	uint64_t render_generation;
+	int render_pending;
+	int render_stop;
 	byte rgb[3];
 	byte brightness;
 	Py_ssize_t num_led_array;
@@ -59,15 +289,132 @@ static PyTypeObject apa102_Type;
 
 #define apa102Object_Check(v)      (Py_TYPE(v) == &apa102_Type)
 
-//helper functions not for use in Python
-void set_pixel_internal(apa102Object *self, int led_num, byte r, byte g, byte b, byte bright_byte) {
-	byte *start_ptr = self->leds + (led_num * BYTES_PER_LED);
+void async_stop_internal(apa102Object *self);
+int async_wait_internal(apa102Object *self, const struct timespec *deadline);
+void record_stop_internal(apa102Object *self);
+void layers_free_internal(apa102Object *self);
+void net_stop_internal(apa102Object *self);
+void shm_detach_internal(apa102Object *self);
+void palette_free_internal(apa102Object *self);
 
+//helper functions not for use in Python
+static inline void mark_dirty(apa102Object *self, Py_ssize_t start, Py_ssize_t end) {
+	//threads drawing different segments can get here at the same time
+	if (self->threaded)
+		pthread_mutex_lock(&self->dirty_lock);
+	if (start < self->dirty_start)
+		self->dirty_start = start;
+	if (end > self->dirty_end)
+		self->dirty_end = end;
+	if (self->threaded)
+		pthread_mutex_unlock(&self->dirty_lock);
+}
+static inline void mark_clean(apa102Object *self) {
+	self->dirty_start = self->num_led;
+	self->dirty_end = 0;
+}
+static inline int is_dirty(apa102Object *self) {
+	//anything holding a buffer can change the pixels without us knowing
+	return self->dirty_start < self->dirty_end || self->exports > 0;
+}
+static inline void count_set_call(apa102Object *self) {
+	if (self->stats_enabled && self->threaded)
+		__atomic_fetch_add(&self->stat_set_calls, 1, __ATOMIC_RELAXED);
+	else if (self->stats_enabled)
+		self->stat_set_calls++;
+}
+//locks the segments holding leds start to end (exclusive), always in order so two threads can't deadlock
+//does nothing unless threaded is set
+static void lock_range(apa102Object *self, Py_ssize_t start, Py_ssize_t end) {
+	if (!self->threaded || start >= end)
+		return;
+	for (Py_ssize_t s = start / self->lock_span; s <= (end-1) / self->lock_span; s++)
+		pthread_mutex_lock(&self->segment_locks[s]);
+}
+static void unlock_range(apa102Object *self, Py_ssize_t start, Py_ssize_t end) {
+	if (!self->threaded || start >= end)
+		return;
+	for (Py_ssize_t s = start / self->lock_span; s <= (end-1) / self->lock_span; s++)
+		pthread_mutex_unlock(&self->segment_locks[s]);
+}
+//for drawing functions: locks leds start to end (exclusive), letting go of the GIL first if count (how many leds get drawn) is large
+//nothing between lock_pixels and unlock_pixels may use the Python API unless count is too small to let go of the GIL
+static PyThreadState * lock_pixels(apa102Object *self, Py_ssize_t start, Py_ssize_t end, Py_ssize_t count) {
+	if (!self->threaded)
+		return NULL;
+	PyThreadState *save = (count >= GIL_RELEASE_LEDS) ? PyEval_SaveThread() : NULL;
+	lock_range(self, start, end);
+	return save;
+}
+static void unlock_pixels(apa102Object *self, Py_ssize_t start, Py_ssize_t end, PyThreadState *save) {
+	unlock_range(self, start, end);
+	if (save != NULL)
+		PyEval_RestoreThread(save);
+}
+//needs the GIL, which is let go while waiting so the thread sending the last frame can finish
+static void lock_show(apa102Object *self) {
+	if (!self->threaded || pthread_mutex_trylock(&self->show_lock) == 0)
+		return;
+	Py_BEGIN_ALLOW_THREADS
+	pthread_mutex_lock(&self->show_lock);
+	Py_END_ALLOW_THREADS
+}
+static void unlock_show(apa102Object *self) {
+	if (self->threaded)
+		pthread_mutex_unlock(&self->show_lock);
+}
+//where led_num is stored, led_num must be in range
+static inline byte * led_ptr(apa102Object *self, Py_ssize_t led_num) {
+	Py_ssize_t index = led_num + self->head;
+	if (index >= self->num_led)
+		index -= self->num_led;
+	return self->leds + index*BYTES_PER_LED;
+}
+static inline void write_led(apa102Object *self, byte *start_ptr, byte r, byte g, byte b, byte bright_byte) {
 	*(start_ptr) = bright_byte;
 	*(start_ptr + self->rgb[RED]) = r;
 	*(start_ptr + self->rgb[GRN]) = g;
 	*(start_ptr + self->rgb[BLU]) = b;
 }
+//reverses the order of the leds from start to end (exclusive) where they are stored
+void reverse_leds(apa102Object *self, Py_ssize_t start, Py_ssize_t end) {
+	byte temp[4];
+	byte *low = self->leds + start*BYTES_PER_LED;
+	byte *high = self->leds + (end-1)*BYTES_PER_LED;
+	while (low < high) {
+		memcpy(temp, low, BYTES_PER_LED);
+		memcpy(low, high, BYTES_PER_LED);
+		memcpy(high, temp, BYTES_PER_LED);
+		low += BYTES_PER_LED;
+		high -= BYTES_PER_LED;
+	}
+}
+//reverses count palette indices in place
+static void reverse_indices(byte *low, Py_ssize_t count) {
+	byte *high = low + count - 1;
+	while (low < high) {
+		byte temp = *low;
+		*low++ = *high;
+		*high-- = temp;
+	}
+}
+//moves the leds in place so led 0 is stored first again, without allocating anything
+void normalize_ring(apa102Object *self) {
+	if (self->head == 0)
+		return;
+	reverse_leds(self, 0, self->head);
+	reverse_leds(self, self->head, self->num_led);
+	reverse_leds(self, 0, self->num_led);
+	self->head = 0;
+}
+//doesn't mark the pixel dirty, for loops that mark their whole range at once
+static inline void write_pixel_internal(apa102Object *self, int led_num, byte r, byte g, byte b, byte bright_byte) {
+	write_led(self, led_ptr(self, led_num), r, g, b, bright_byte);
+}
+void set_pixel_internal(apa102Object *self, int led_num, byte r, byte g, byte b, byte bright_byte) {
+	write_pixel_internal(self, led_num, r, g, b, bright_byte);
+	mark_dirty(self, led_num, led_num+1);
+}
 byte get_bright_byte(apa102Object *self, byte brightness) {
 	if (brightness >= MAX_BRIGHTNESS)
 		return (brightness & LED_BRIGHT_MASK) | LED_START;
@@ -79,46 +426,718 @@ void get_rgb_internal(int rgb, byte *r, byte *g, byte *b) {
 	*g = (rgb >> 8) & 255;
 	*b = rgb & 255;
 }
+//a piece of a frame, a frame is sent as up to 4 of these when leds has to be sent in two parts
+typedef struct {
+	const byte *data;
+	Py_ssize_t len;
+} segment;
+#define MAX_SEGMENTS 4
+
+void gather_segments(byte *dst, const segment *segs, int count) {
+	for (int i = 0; i < count; i++) {
+		memcpy(dst, segs[i].data, segs[i].len);
+		dst += segs[i].len;
+	}
+}
+
+//the start of a shared memory frame, the leds follow at SHM_HEADER_BYTES in the same layout as leds
+//seq is a seqlock: it is odd while a frame is being written, so a frame read between two equal even values is whole
+typedef struct {
+	char magic[8];
+	uint32_t num_led;
+	uint32_t seq;
+	uint64_t frames; //how many frames have been written
+	int32_t writer; //pid of the process writing a frame, 0 when no one is or it hasn't said yet
+} shm_header;
+#define SHM_HEADER_BYTES 64 //the leds start on their own cache line
+static const char SHM_MAGIC[8] = {'A', 'P', 'A', '1', '0', '2', 'S', 1};
+
+int shm_read_internal(apa102Object *self, byte *wire);
+int shm_write_internal(apa102Object *self, const segment *segs, int count);
+
+//whether show() has anything new to send: a frame written to shared memory since the last one read, or leds that changed
+static inline int frame_pending(apa102Object *self) {
+	if (self->shm_mode == SHM_READ)
+		return __atomic_load_n(&((shm_header*)self->shm)->seq, __ATOMIC_ACQUIRE) != self->shm_seq;
+	return is_dirty(self);
+}
+
+static uint64_t monotonic_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+//Get a color from a color wheel; Green -> Red -> Blue -> Green
+long wheel_internal(byte pos) {
+	long rgb;
+	if (pos < 85){  //Green -> Red
+		pos *= 3;
+		rgb = (pos << 16) | ((255-pos) << 8);
+	}
+	else if (pos < 170){  // Red -> Blue
+		pos = (pos - 85)*3;
+		rgb = ((255-pos) << 16) | pos;
+	}
+	else { // Blue -> Green
+		pos = (pos-170)*3;
+		rgb = (pos << 8) | (255-pos);
+	}
+	return rgb;
+}
+
+//HSV to RGB in fixed point. hue is 16 bits for the whole circle (so 8 bit hues wrap around at 256 like wheel()),
+//saturation and value are 0 to 65535. every channel is worked out by the same min/max formula instead of
+//picking a sector with branches, so the loops below can be vectorized by the compiler
+#define HSV_BLOCK 256 //pixels converted at a time before they are put into leds
+static inline byte hsv_channel(uint32_t h6, uint32_t s, uint32_t v, int32_t n) {
+	//k is where the hue is for this channel in sixths of the circle, 16.16 fixed point
+	int32_t k = n*65536 + (int32_t)h6;
+	k = (k >= 6*65536) ? k - 6*65536 : k;
+	int32_t m = (k < 4*65536 - k) ? k : 4*65536 - k;
+	m = (m < 0) ? 0 : (m > 65536) ? 65536 : m;
+	uint32_t sm = (s * (uint32_t)m) >> 16;
+	uint32_t level = v - ((v * sm) >> 16);
+	return (level * 255 + 32895) >> 16;
+}
+static inline void hsv_pixel(byte *dst, uint32_t h, uint32_t s, uint32_t v) {
+	uint32_t h6 = h * 6;
+	*(dst) = hsv_channel(h6, s, v, 5);
+	*(dst+1) = hsv_channel(h6, s, v, 3);
+	*(dst+2) = hsv_channel(h6, s, v, 1);
+}
+//converts count pixels of packed h, s, v (bytes, or native uint16s if wide) into packed r, g, b bytes
+void hsv_to_rgb_internal(byte *dst, const void *src, Py_ssize_t count, int wide) {
+	if (wide) {
+		const uint16_t *hsv = (const uint16_t*)src;
+		for (Py_ssize_t i = 0; i < count; i++)
+			hsv_pixel(dst + i*3, hsv[i*3], hsv[i*3+1], hsv[i*3+2]);
+	}
+	else {
+		const byte *hsv = (const byte*)src;
+		for (Py_ssize_t i = 0; i < count; i++)
+			hsv_pixel(dst + i*3, hsv[i*3] << 8, hsv[i*3+1] * 257, hsv[i*3+2] * 257);
+	}
+}
+
+//called without the GIL, returns 0 or an errno value
+int write_fd_internal(apa102Object *self, const segment *segs, int count) {
+#ifdef __linux__
+	if (self->is_spidev) {
+		//spidev won't take a message longer than its bufsiz, so the frame goes out as messages of up to chunk_size bytes.
+		//apa102s don't use chip select, so it going up between messages doesn't matter
+		struct spi_ioc_transfer transfers[MAX_SEGMENTS];
+		Py_ssize_t chunk = (self->chunk_size > 0) ? self->chunk_size : PY_SSIZE_T_MAX;
+		//a transfer's len is 32 bits. compared as size_t since UINT32_MAX doesn't fit in a 32 bit Py_ssize_t
+		if ((size_t)chunk > (size_t)UINT32_MAX)
+			chunk = UINT32_MAX;
+		Py_ssize_t message_len = 0;
+		int transfer_count = 0;
+		memset(transfers, 0, sizeof(transfers));
+		for (int i = 0; i < count; i++) {
+			const byte *data = segs[i].data;
+			Py_ssize_t len = segs[i].len;
+			while (len > 0) {
+				Py_ssize_t piece = (len < chunk - message_len) ? len : chunk - message_len;
+				transfers[transfer_count].tx_buf = (unsigned long)data;
+				transfers[transfer_count].len = (uint32_t)piece;
+				transfers[transfer_count].speed_hz = self->speed_hz;
+				transfers[transfer_count].bits_per_word = 8;
+				transfer_count++;
+				message_len += piece;
+				data += piece;
+				len -= piece;
+				if (message_len == chunk || transfer_count == MAX_SEGMENTS) {
+					if (ioctl(self->fd, SPI_IOC_MESSAGE(transfer_count), transfers) < 0)
+						return errno;
+					memset(transfers, 0, sizeof(transfers));
+					transfer_count = 0;
+					message_len = 0;
+				}
+			}
+		}
+		if (transfer_count > 0 && ioctl(self->fd, SPI_IOC_MESSAGE(transfer_count), transfers) < 0)
+			return errno;
+		return 0;
+	}
+#endif
+	//anything that isn't a spidev device (pipes, files, sockets) just gets written to
+	for (int i = 0; i < count; i++) {
+		const byte *data = segs[i].data;
+		Py_ssize_t len = segs[i].len;
+		while (len > 0) {
+			ssize_t written = write(self->fd, data, len);
+			if (written < 0) {
+				if (errno == EINTR)
+					continue;
+				return errno;
+			}
+			data += written;
+			len -= written;
+		}
+	}
+	return 0;
+}
+#ifdef __linux__
+//the most bytes the spidev driver takes in one message, 4096 unless the module was loaded with another bufsiz
+Py_ssize_t spidev_bufsiz(void) {
+	long bufsiz = 0;
+	FILE *file = fopen("/sys/module/spidev/parameters/bufsiz", "re");
+	if (file != NULL) {
+		if (fscanf(file, "%ld", &bufsiz) != 1)
+			bufsiz = 0;
+		fclose(file);
+	}
+	return (bufsiz > 0) ? bufsiz : 4096;
+}
+#endif
+void close_fd_internal(apa102Object *self) {
+	if (self->owns_fd && self->fd >= 0)
+		close(self->fd);
+	self->fd = -1;
+	self->owns_fd = 0;
+	self->is_spidev = 0;
+}
+
+//swizzle kernels: turn packed RGB (stride 3) or RGBA (stride 4) pixels into the 4 byte led format
+//src_off gives where red, green, and blue are in each source pixel and dst_off where they go (self->rgb)
+typedef void (*swizzle_func)(byte*, const byte*, Py_ssize_t, int, const byte*, const byte*, byte);
+
+void swizzle_scalar(byte *dst, const byte *src, Py_ssize_t count, int stride, const byte *src_off, const byte *dst_off, byte bright_byte) {
+	for (Py_ssize_t i = 0; i < count; i++) {
+		*(dst) = bright_byte;
+		*(dst + dst_off[RED]) = *(src + src_off[RED]);
+		*(dst + dst_off[GRN]) = *(src + src_off[GRN]);
+		*(dst + dst_off[BLU]) = *(src + src_off[BLU]);
+		dst += BYTES_PER_LED;
+		src += stride;
+	}
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_X86_SWIZZLE 1
+//builds the pshufb mask for 4 pixels, 0x80 zeroes the brightness byte so it can be ored in after
+static void swizzle_mask(byte *mask, int stride, const byte *src_off, const byte *dst_off) {
+	for (int p = 0; p < 4; p++) {
+		*(mask + p*BYTES_PER_LED) = 0x80;
+		for (int c = RED; c <= BLU; c++)
+			*(mask + p*BYTES_PER_LED + dst_off[c]) = p*stride + src_off[c];
+	}
+}
+__attribute__((target("ssse3")))
+void swizzle_ssse3(byte *dst, const byte *src, Py_ssize_t count, int stride, const byte *src_off, const byte *dst_off, byte bright_byte) {
+	byte mask_bytes[16];
+	swizzle_mask(mask_bytes, stride, src_off, dst_off);
+	__m128i mask = _mm_loadu_si128((const __m128i*)mask_bytes);
+	__m128i bright = _mm_set1_epi32(bright_byte);
+	Py_ssize_t i = 0;
+	//every load reads 16 bytes, with RGB input that is 4 bytes past the 4 pixels it uses
+	for (; (i+4)*stride + (16 - 4*stride) <= count*stride; i += 4) {
+		__m128i in = _mm_loadu_si128((const __m128i*)(src + i*stride));
+		_mm_storeu_si128((__m128i*)(dst + i*BYTES_PER_LED), _mm_or_si128(_mm_shuffle_epi8(in, mask), bright));
+	}
+	swizzle_scalar(dst + i*BYTES_PER_LED, src + i*stride, count - i, stride, src_off, dst_off, bright_byte);
+}
+__attribute__((target("avx2")))
+void swizzle_avx2(byte *dst, const byte *src, Py_ssize_t count, int stride, const byte *src_off, const byte *dst_off, byte bright_byte) {
+	byte mask_bytes[16];
+	swizzle_mask(mask_bytes, stride, src_off, dst_off);
+	//vpshufb works on each 128 bit lane by itself, so each lane gets its own 4 pixels
+	__m256i mask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)mask_bytes));
+	__m256i bright = _mm256_set1_epi32(bright_byte);
+	Py_ssize_t i = 0;
+	for (; (i+8)*stride + (16 - 4*stride) <= count*stride; i += 8) {
+		__m128i lo = _mm_loadu_si128((const __m128i*)(src + i*stride));
+		__m128i hi = _mm_loadu_si128((const __m128i*)(src + (i+4)*stride));
+		__m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		_mm256_storeu_si256((__m256i*)(dst + i*BYTES_PER_LED), _mm256_or_si256(_mm256_shuffle_epi8(in, mask), bright));
+	}
+	swizzle_ssse3(dst + i*BYTES_PER_LED, src + i*stride, count - i, stride, src_off, dst_off, bright_byte);
+}
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HAVE_NEON_SWIZZLE 1
+void swizzle_neon(byte *dst, const byte *src, Py_ssize_t count, int stride, const byte *src_off, const byte *dst_off, byte bright_byte) {
+	Py_ssize_t i = 0;
+	uint8x16x4_t out;
+	out.val[0] = vdupq_n_u8(bright_byte);
+	//vld3/vld4 split the pixels into one register per channel, vst4 puts them back together in led order
+	if (stride == 3) {
+		for (; i+16 <= count; i += 16) {
+			uint8x16x3_t in = vld3q_u8(src + i*stride);
+			out.val[dst_off[RED]] = in.val[src_off[RED]];
+			out.val[dst_off[GRN]] = in.val[src_off[GRN]];
+			out.val[dst_off[BLU]] = in.val[src_off[BLU]];
+			vst4q_u8(dst + i*BYTES_PER_LED, out);
+		}
+	}
+	else {
+		for (; i+16 <= count; i += 16) {
+			uint8x16x4_t in = vld4q_u8(src + i*stride);
+			out.val[dst_off[RED]] = in.val[src_off[RED]];
+			out.val[dst_off[GRN]] = in.val[src_off[GRN]];
+			out.val[dst_off[BLU]] = in.val[src_off[BLU]];
+			vst4q_u8(dst + i*BYTES_PER_LED, out);
+		}
+	}
+	swizzle_scalar(dst + i*BYTES_PER_LED, src + i*stride, count - i, stride, src_off, dst_off, bright_byte);
+}
+#endif
+
+//blend kernels: draw count pixels of a layer over dst, which already holds everything under it
+//the 5 bit brightness of each layer pixel times the layer's opacity is its alpha, alpha_scale is opacity*255*256/31
+//colors become dst + (target - dst) * alpha, where target depends on the mode, and the brightness goes up toward MAX_BRIGHTNESS the same way
+enum {BLEND_NORMAL, BLEND_ADD, BLEND_MULTIPLY, BLEND_SCREEN, BLEND_MAX};
+static const char *BLEND_MODES[] = {"normal", "add", "multiply", "screen", "max", NULL};
+typedef void (*blend_func)(byte*, const byte*, Py_ssize_t, int, uint16_t);
+
+//x/255 rounded, exact for anything up to 255*255
+static inline uint32_t div255(uint32_t x) {
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+void blend_scalar(byte *dst, const byte *src, Py_ssize_t count, int mode, uint16_t alpha_scale) {
+	for (Py_ssize_t i = 0; i < count; i++) {
+		uint32_t alpha = ((*(src) & LED_BRIGHT_MASK) * alpha_scale) >> 8;
+		*(dst) = LED_START | div255((*(dst) & LED_BRIGHT_MASK) * (255 - alpha) + MAX_BRIGHTNESS * alpha);
+		for (int j = 1; j < BYTES_PER_LED; j++) {
+			uint32_t under = *(dst+j), over = *(src+j), target;
+			switch (mode) {
+				case BLEND_ADD:
+					target = (under + over > 255) ? 255 : under + over;
+					break;
+				case BLEND_MULTIPLY:
+					target = div255(under * over);
+					break;
+				case BLEND_SCREEN:
+					target = 255 - div255((255 - under) * (255 - over));
+					break;
+				case BLEND_MAX:
+					target = (under > over) ? under : over;
+					break;
+				default:
+					target = over;
+			}
+			*(dst+j) = div255(under * (255 - alpha) + target * alpha);
+		}
+		dst += BYTES_PER_LED;
+		src += BYTES_PER_LED;
+	}
+}
+
+#ifdef HAVE_X86_SWIZZLE
+//the same math as blend_scalar on 2 pixels widened to 16 bits, lane 0 and 4 are the brightness bytes
+static inline __m128i div255_sse2(__m128i x) {
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+static inline __m128i blend2_sse2(__m128i under, __m128i over, int mode, __m128i alpha_scale) {
+	const __m128i bright_lanes = _mm_set_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+	const __m128i all = _mm_set1_epi16(255);
+	__m128i alpha = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(over, _mm_set1_epi16(LED_BRIGHT_MASK)), alpha_scale), 8);
+	alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(alpha, 0), 0);
+	__m128i target;
+	switch (mode) {
+		case BLEND_ADD:
+			target = _mm_min_epi16(_mm_add_epi16(under, over), all);
+			break;
+		case BLEND_MULTIPLY:
+			target = div255_sse2(_mm_mullo_epi16(under, over));
+			break;
+		case BLEND_SCREEN:
+			target = _mm_sub_epi16(all, div255_sse2(_mm_mullo_epi16(_mm_sub_epi16(all, under), _mm_sub_epi16(all, over))));
+			break;
+		case BLEND_MAX:
+			target = _mm_max_epi16(under, over);
+			break;
+		default:
+			target = over;
+	}
+	//the brightness lanes blend toward MAX_BRIGHTNESS from the 5 bit value
+	under = _mm_andnot_si128(_mm_and_si128(bright_lanes, _mm_set1_epi16(LED_START)), under);
+	target = _mm_or_si128(_mm_andnot_si128(bright_lanes, target), _mm_and_si128(bright_lanes, _mm_set1_epi16(MAX_BRIGHTNESS)));
+	__m128i out = div255_sse2(_mm_add_epi16(_mm_mullo_epi16(under, _mm_sub_epi16(all, alpha)), _mm_mullo_epi16(target, alpha)));
+	return _mm_or_si128(out, _mm_and_si128(bright_lanes, _mm_set1_epi16(LED_START)));
+}
+void blend_sse2(byte *dst, const byte *src, Py_ssize_t count, int mode, uint16_t alpha_scale) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i scale = _mm_set1_epi16(alpha_scale);
+	Py_ssize_t i = 0;
+	for (; i+4 <= count; i += 4) {
+		__m128i under = _mm_loadu_si128((const __m128i*)(dst + i*BYTES_PER_LED));
+		__m128i over = _mm_loadu_si128((const __m128i*)(src + i*BYTES_PER_LED));
+		__m128i lo = blend2_sse2(_mm_unpacklo_epi8(under, zero), _mm_unpacklo_epi8(over, zero), mode, scale);
+		__m128i hi = blend2_sse2(_mm_unpackhi_epi8(under, zero), _mm_unpackhi_epi8(over, zero), mode, scale);
+		_mm_storeu_si128((__m128i*)(dst + i*BYTES_PER_LED), _mm_packus_epi16(lo, hi));
+	}
+	blend_scalar(dst + i*BYTES_PER_LED, src + i*BYTES_PER_LED, count - i, mode, alpha_scale);
+}
+#endif
+
+#ifdef HAVE_NEON_SWIZZLE
+static inline uint16x8_t div255_neon(uint16x8_t x) {
+	x = vaddq_u16(x, vdupq_n_u16(128));
+	return vshrq_n_u16(vaddq_u16(x, vshrq_n_u16(x, 8)), 8);
+}
+static inline uint16x8_t blend2_neon(uint16x8_t under, uint16x8_t over, int mode, uint16_t alpha_scale) {
+	const uint16x8_t all = vdupq_n_u16(255);
+	const uint16_t lanes[8] = {0xFFFF, 0, 0, 0, 0xFFFF, 0, 0, 0};
+	const uint16x8_t bright_lanes = vld1q_u16(lanes);
+	uint16x8_t alpha = vshrq_n_u16(vmulq_n_u16(vandq_u16(over, vdupq_n_u16(LED_BRIGHT_MASK)), alpha_scale), 8);
+	alpha = vcombine_u16(vdup_lane_u16(vget_low_u16(alpha), 0), vdup_lane_u16(vget_high_u16(alpha), 0));
+	uint16x8_t target;
+	switch (mode) {
+		case BLEND_ADD:
+			target = vminq_u16(vaddq_u16(under, over), all);
+			break;
+		case BLEND_MULTIPLY:
+			target = div255_neon(vmulq_u16(under, over));
+			break;
+		case BLEND_SCREEN:
+			target = vsubq_u16(all, div255_neon(vmulq_u16(vsubq_u16(all, under), vsubq_u16(all, over))));
+			break;
+		case BLEND_MAX:
+			target = vmaxq_u16(under, over);
+			break;
+		default:
+			target = over;
+	}
+	under = vbslq_u16(bright_lanes, vandq_u16(under, vdupq_n_u16(LED_BRIGHT_MASK)), under);
+	target = vbslq_u16(bright_lanes, vdupq_n_u16(MAX_BRIGHTNESS), target);
+	uint16x8_t out = div255_neon(vmlaq_u16(vmulq_u16(under, vsubq_u16(all, alpha)), target, alpha));
+	return vorrq_u16(out, vandq_u16(bright_lanes, vdupq_n_u16(LED_START)));
+}
+void blend_neon(byte *dst, const byte *src, Py_ssize_t count, int mode, uint16_t alpha_scale) {
+	Py_ssize_t i = 0;
+	for (; i+4 <= count; i += 4) {
+		uint8x16_t under = vld1q_u8(dst + i*BYTES_PER_LED);
+		uint8x16_t over = vld1q_u8(src + i*BYTES_PER_LED);
+		uint16x8_t lo = blend2_neon(vmovl_u8(vget_low_u8(under)), vmovl_u8(vget_low_u8(over)), mode, alpha_scale);
+		uint16x8_t hi = blend2_neon(vmovl_u8(vget_high_u8(under)), vmovl_u8(vget_high_u8(over)), mode, alpha_scale);
+		vst1q_u8(dst + i*BYTES_PER_LED, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+	}
+	blend_scalar(dst + i*BYTES_PER_LED, src + i*BYTES_PER_LED, count - i, mode, alpha_scale);
+}
+#endif
+
+//picked once when the module is loaded
+static swizzle_func swizzle_kernel = swizzle_scalar;
+static blend_func blend_kernel = blend_scalar;
+void select_kernels(void) {
+#ifdef HAVE_NEON_SWIZZLE
+	swizzle_kernel = swizzle_neon;
+	blend_kernel = blend_neon;
+#endif
+#ifdef HAVE_X86_SWIZZLE
+	//every x86_64 cpu has sse2
+	blend_kernel = blend_sse2;
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		swizzle_kernel = swizzle_avx2;
+	else if (__builtin_cpu_supports("ssse3"))
+		swizzle_kernel = swizzle_ssse3;
+#endif
+}
+
+//reads a layout like "rgb", "bgr" or "rgba" into the offset of each channel, returns the stride or 0 if it is invalid
+int parse_layout(const char *layout, byte *src_off) {
+	int len = strlen(layout);
+	if (len != 3 && len != 4)
+		return 0;
+	byte r_count = 0, g_count = 0, b_count = 0, other_count = 0;
+	for (int i = 0; i < len; i++) {
+		char loopC = *(layout+i);
+		if (loopC == 'r' || loopC == 'R') {
+			src_off[RED] = i;
+			r_count++;
+		}
+		else if (loopC == 'g' || loopC == 'G') {
+			src_off[GRN] = i;
+			g_count++;
+		}
+		else if (loopC == 'b' || loopC == 'B') {
+			src_off[BLU] = i;
+			b_count++;
+		}
+		else if (loopC == 'a' || loopC == 'A' || loopC == 'x' || loopC == 'X')
+			other_count++;
+		else
+			return 0;
+	}
+	if (r_count != 1 || g_count != 1 || b_count != 1 || other_count != len-3)
+		return 0;
+	return len;
+}
+
+//render pool: set_render_threads() starts render_threads-1 workers that sleep until a job comes in.
+//render_range hands each worker a slice of the range and does the first one itself, so the caller keeps the GIL
+//and nothing it does changes. the work functions must not use the Python API
+static void * render_worker(void *arg) {
+	apa102Object *self = (apa102Object*)arg;
+	pthread_mutex_lock(&self->render_lock);
+	//workers number themselves in the order they start
+	int index = ++self->render_pending;
+	pthread_cond_broadcast(&self->render_done);
+	uint64_t seen = self->render_generation;
+	for (;;) {
+		while (!self->render_stop && self->render_generation == seen)
+			pthread_cond_wait(&self->render_cond, &self->render_lock);
+		if (self->render_stop)
+			break;
+		seen = self->render_generation;
+		render_fn job = self->render_job;
+		const void *job_arg = self->render_arg;
+		Py_ssize_t start = self->render_start + index*self->render_slice;
+		Py_ssize_t end = (self->render_end - start > self->render_slice) ? start + self->render_slice : self->render_end;
+		pthread_mutex_unlock(&self->render_lock);
+		
+		if (start < end)
+			job(self, job_arg, start, end);
+		
+		pthread_mutex_lock(&self->render_lock);
+		if (--self->render_pending == 0)
+			pthread_cond_signal(&self->render_done);
+	}
+	pthread_mutex_unlock(&self->render_lock);
+	return NULL;
+}
+
+//runs job over leds start to end (exclusive), split between the pool if the range is big enough
+void render_range(apa102Object *self, render_fn job, const void *arg, Py_ssize_t start, Py_ssize_t end) {
+	//if another thread is using the pool this range is done alone instead of waiting
+	if (self->render_threads < 2 || end - start < self->render_min_leds || pthread_mutex_trylock(&self->render_busy) != 0) {
+		job(self, arg, start, end);
+		return;
+	}
+	//render_threads only changes while render_busy is held, so read it again now that it is ours
+	int threads = self->render_threads;
+	if (threads < 2) {
+		pthread_mutex_unlock(&self->render_busy);
+		job(self, arg, start, end);
+		return;
+	}
+	Py_ssize_t slice = (end - start + threads - 1) / threads;
+	slice = (slice + LEDS_PER_LINE - 1) / LEDS_PER_LINE * LEDS_PER_LINE;
+	pthread_mutex_lock(&self->render_lock);
+	self->render_job = job;
+	self->render_arg = arg;
+	self->render_start = start;
+	self->render_end = end;
+	self->render_slice = slice;
+	self->render_pending = threads - 1;
+	self->render_generation++;
+	pthread_cond_broadcast(&self->render_cond);
+	pthread_mutex_unlock(&self->render_lock);
+	
+	job(self, arg, start, (end - start > slice) ? start + slice : end);
+	
+	pthread_mutex_lock(&self->render_lock);
+	while (self->render_pending > 0)
+		pthread_cond_wait(&self->render_done, &self->render_lock);
+	pthread_mutex_unlock(&self->render_lock);
+	pthread_mutex_unlock(&self->render_busy);
+}
+
+//stops and joins the workers, needs render_busy and is called without the GIL
+static void render_join_internal(apa102Object *self) {
+	pthread_mutex_lock(&self->render_lock);
+	self->render_stop = 1;
+	pthread_cond_broadcast(&self->render_cond);
+	pthread_mutex_unlock(&self->render_lock);
+	for (int i = 0; i < self->render_threads - 1; i++)
+		pthread_join(self->render_pool[i], NULL);
+	self->render_threads = 1;
+	self->render_stop = 0;
+}
+
+//stops the workers, needs the GIL, which is let go while waiting for a job that is running to finish
+void render_stop_internal(apa102Object *self) {
+	pthread_t *pool = NULL;
+	if (self->render_pool == NULL)
+		return;
+	Py_BEGIN_ALLOW_THREADS
+	pthread_mutex_lock(&self->render_busy);
+	pool = self->render_pool;
+	if (pool != NULL)
+		render_join_internal(self);
+	self->render_pool = NULL;
+	pthread_mutex_unlock(&self->render_busy);
+	Py_END_ALLOW_THREADS
+	PyMem_Free(pool);
+}
+
+//starts threads-1 workers, returns 0 or -1 with an exception set.
+//render_busy is held throughout so render_range never sees a half started pool
+int render_start_internal(apa102Object *self, int threads) {
+	pthread_t *pool = PyMem_Calloc(threads - 1, sizeof(pthread_t));
+	if (pool == NULL) {
+		PyErr_NoMemory();
+		return -1;
+	}
+	int err = 0;
+	Py_BEGIN_ALLOW_THREADS
+	pthread_mutex_lock(&self->render_busy);
+	self->render_pool = pool;
+	self->render_pending = 0;
+	int started = 0;
+	for (; started < threads - 1; started++) {
+		err = pthread_create(&pool[started], NULL, render_worker, self);
+		if (err)
+			break;
+	}
+	//wait for every worker to take its number so the first job can't be missed
+	pthread_mutex_lock(&self->render_lock);
+	while (self->render_pending < started)
+		pthread_cond_wait(&self->render_done, &self->render_lock);
+	self->render_pending = 0;
+	pthread_mutex_unlock(&self->render_lock);
+	self->render_threads = started + 1;
+	if (err) {
+		render_join_internal(self);
+		self->render_pool = NULL;
+	}
+	pthread_mutex_unlock(&self->render_busy);
+	Py_END_ALLOW_THREADS
+	if (err) {
+		PyMem_Free(pool);
+		errno = err;
+		PyErr_SetFromErrno(PyExc_OSError);
+		return -1;
+	}
+	return 0;
+}
 
 //Python functions:
+static PyObject * apa102_new(PyTypeObject *type, PyObject *args, PyObject *keywds) {
+	apa102Object *self = (apa102Object*)type->tp_alloc(type, 0);
+	if (self != NULL) {
+		self->fd = -1;
+		self->net_fd = -1;
+		self->async_depth = 1;
+		self->gamma = 1.0;
+		self->dimmer = 255;
+		self->random_state = (uint32_t)monotonic_ns() | 1;
+		for (int i = 0; i < 256; i++) {
+			self->gamma_table[i] = i;
+			self->gamma_table16[i] = i * 257;
+			self->lut[i] = i;
+			self->lut16[i] = i * 257;
+		}
+		pthread_mutex_init(&self->async_lock, NULL);
+		pthread_cond_init(&self->async_cond, NULL);
+		for (int i = 0; i < LOCK_SEGMENTS; i++)
+			pthread_mutex_init(&self->segment_locks[i], NULL);
+		pthread_mutex_init(&self->dirty_lock, NULL);
+		pthread_mutex_init(&self->show_lock, NULL);
+		self->render_threads = 1;
+		self->render_min_leds = RENDER_MIN_LEDS;
+		pthread_mutex_init(&self->render_busy, NULL);
+		pthread_mutex_init(&self->render_lock, NULL);
+		pthread_cond_init(&self->render_cond, NULL);
+		pthread_cond_init(&self->render_done, NULL);
+	}
+	return (PyObject*)self;
+}
+
 static int apa102_init (apa102Object *self, PyObject *args, PyObject *keywds){
 	
 	char *order = NULL;
-	self->brightness = MAX_BRIGHTNESS;
+	PyObject *write_callback;
+	unsigned int speed_hz = 0;
+	Py_ssize_t chunk_size = -1;
+	int threaded = 0;
+	int num_led;
+	byte brightness = MAX_BRIGHTNESS;
+	int legacy_list = 0;
 	
-	static char *kwlist[] = {"num_led", "write_callback", "global_brightness", "order", NULL};
-	static const char *types = "iO|bz:__init__";
+	//another thread could be drawing on a threaded strip without the GIL, so it can't be set up again
+	if (self->threaded) {
+		PyErr_SetString(PyExc_RuntimeError, "cannot reinitialize a strip created with threaded=True");
+		return -1;
+	}
 	
-	PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &(self->num_led), &self->spi_write, &(self->brightness), &order);
+	static char *kwlist[] = {"num_led", "write_callback", "global_brightness", "order", "legacy_list", "speed_hz", "chunk_size", "threaded", NULL};
+	static const char *types = "iO|bzpInp:__init__";
 	
+	//parsed into locals so a failed call leaves the old frame and its size untouched
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &num_led, &write_callback, &brightness, &order, &legacy_list, &speed_hz, &chunk_size, &threaded))
+		return -1;
 	
-	if (self->spi_write == Py_None)
-		self->spi_write = NULL;
-	else if (!PyCallable_Check(self->spi_write)) {
-			PyErr_SetString(PyExc_TypeError, "parameter spi_write must be callable or None");
-			return -1;
+	if (self->transmitting) {
+		PyErr_SetString(PyExc_RuntimeError, "cannot reinitialize while show() is running");
+		return -1;
+	}
+	if (self->exports > 0) {
+		PyErr_SetString(PyExc_BufferError, "cannot reinitialize while the pixels are exported");
+		return -1;
+	}
+	if (self->frame_exports > 0) {
+		PyErr_SetString(PyExc_BufferError, "cannot reinitialize while write_callback holds on to a frame");
+		return -1;
 	}
-	else
-		Py_INCREF(self->spi_write);
 	
-	if (self->brightness > MAX_BRIGHTNESS)
-		self->brightness = MAX_BRIGHTNESS;
+	//nothing below touches the strip until every check has passed and the new frame is allocated
+	if (num_led < 0) {
+		PyErr_SetString(PyExc_ValueError, "num_led must not be negative");
+		return -1;
+	}
+	//the frame is 4 bytes per led plus 1 for every 16, that has to fit in a Py_ssize_t
+	if ((size_t)num_led > (size_t)(PY_SSIZE_T_MAX - START_FRAME_BYTES - 1) / (BYTES_PER_LED + 1)) {
+		PyErr_SetString(PyExc_OverflowError, "num_led is too large");
+		return -1;
+	}
+	if (chunk_size < -1) {
+		PyErr_SetString(PyExc_ValueError, "chunk_size must not be negative");
+		return -1;
+	}
+	
+	int fd = -1, owns_fd = 0;
+	if (PyLong_Check(write_callback)) {
+		long fd_long = PyLong_AsLong(write_callback);
+		if (fd_long == -1 && PyErr_Occurred())
+			return -1;
+		if (fd_long < 0 || fd_long > INT_MAX) {
+			PyErr_SetString(PyExc_ValueError, "file descriptor out of range");
+			return -1;
+		}
+		fd = (int)fd_long;
+	}
+	else if (PyUnicode_Check(write_callback) || PyBytes_Check(write_callback) || PyObject_HasAttrString(write_callback, "__fspath__")) {
+		PyObject *path = NULL;
+		if (!PyUnicode_FSConverter(write_callback, &path))
+			return -1;
+		fd = open(PyBytes_AS_STRING(path), O_WRONLY | O_CLOEXEC);
+		if (fd < 0) {
+			PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, write_callback);
+			Py_DECREF(path);
+			return -1;
+		}
+		Py_DECREF(path);
+		owns_fd = 1;
+	}
+	else if (write_callback != Py_None && !PyCallable_Check(write_callback)) {
+			PyErr_SetString(PyExc_TypeError, "parameter spi_write must be callable, a path, a file descriptor, or None");
+			return -1;
+	}
 	
+	byte rgb[3];
 	int use_default_rgb = (order == NULL);
 	if (!use_default_rgb) {
 		byte r_count = 0, b_count = 0, g_count = 0;
 		for (int i = 0; i < 3; i++) {
 			char loopC = *(order+i);
 			if (loopC == 'r' || loopC == 'R') {
-				self->rgb[RED] = 3-i;
+				rgb[RED] = 3-i;
 				r_count++;
 			}
 			else if (loopC == 'g' || loopC == 'G') {
-				self->rgb[GRN] = 3-i;
+				rgb[GRN] = 3-i;
 				g_count++;
 			}
 			else if (loopC == 'b' || loopC == 'B') {
-				self->rgb[BLU] = 3-i;
+				rgb[BLU] = 3-i;
 				b_count++;
 			}
 			else if (loopC == '\0')
@@ -129,19 +1148,83 @@ static int apa102_init (apa102Object *self, PyObject *args, PyObject *keywds){
 	}
 	
 	if (use_default_rgb) {
-		self->rgb[0] = 3;
-		self->rgb[1] = 2;
-		self->rgb[2] = 1;
+		rgb[0] = 3;
+		rgb[1] = 2;
+		rgb[2] = 1;
+	}
+	
+	//the frame is kept laid out exactly as it goes out on the wire, so show() never has to build it:
+	//4 0-bytes, the leds, then (num_led+15)/16 0-bytes to clock the data through the whole strip
+	Py_ssize_t num_led_array = (Py_ssize_t)num_led * BYTES_PER_LED;
+	Py_ssize_t end_bytes = (num_led + 15) / 16;
+	Py_ssize_t frame_len = START_FRAME_BYTES + num_led_array + end_bytes;
+	byte *frame = (byte*) PyMem_Calloc(frame_len, sizeof(byte));
+	if (frame == NULL) {
+		if (owns_fd)
+			close(fd);
+		PyErr_NoMemory();
+		return -1;
+	}
+	
+	//__init__ can be called more than once, so let go of anything from the last call
+	net_stop_internal(self);
+	async_stop_internal(self);
+	shm_detach_internal(self);
+	record_stop_internal(self);
+	layers_free_internal(self);
+	palette_free_internal(self);
+	Py_CLEAR(self->async_error);
+	Py_CLEAR(self->net_error);
+	Py_CLEAR(self->frame_list);
+	Py_CLEAR(self->spi_write);
+	close_fd_internal(self);
+	PyMem_Free(self->frame);
+	PyMem_Free(self->wire);
+	self->wire = NULL;
+	self->head = 0;
+	
+	if (fd >= 0) {
+		self->fd = fd;
+		self->owns_fd = owns_fd;
+		self->speed_hz = speed_hz;
+#ifdef __linux__
+		//only spidev devices understand this, everything else gets plain write() calls
+		byte mode;
+		self->is_spidev = (ioctl(fd, SPI_IOC_RD_MODE, &mode) == 0);
+		if (self->is_spidev && chunk_size < 0)
+			chunk_size = spidev_bufsiz();
+#endif
 	}
+	else if (write_callback != Py_None) {
+		Py_INCREF(write_callback);
+		self->spi_write = write_callback;
+	}
+	
+	self->chunk_size = (chunk_size > 0) ? chunk_size : 0;
+	self->num_led = num_led;
+	self->brightness = (brightness > MAX_BRIGHTNESS) ? MAX_BRIGHTNESS : brightness;
+	self->legacy_list = legacy_list;
+	memcpy(self->rgb, rgb, sizeof(rgb));
 	
-	self->num_led_array = self->num_led * BYTES_PER_LED;
-	self->leds = (byte*) PyMem_Calloc(self->num_led_array, sizeof(byte));
-	for (int i = 0; (i+3) < self->num_led_array; i+= 4) 
+	self->num_led_array = num_led_array;
+	self->frame_len = frame_len;
+	self->frame = frame;
+	self->leds = self->frame + START_FRAME_BYTES;
+	self->shape[0] = self->num_led;
+	self->shape[1] = BYTES_PER_LED;
+	self->strides[0] = BYTES_PER_LED;
+	self->strides[1] = 1;
+	for (Py_ssize_t i = 0; (i+3) < self->num_led_array; i+= 4) 
 	{
 		*(self->leds+i) = LED_START;
 	}
-	
-	//create the objects:
+	//the first frame always goes out
+	self->dirty_start = 0;
+	self->dirty_end = self->num_led;
+	self->lock_span = (self->num_led + LOCK_SEGMENTS - 1) / LOCK_SEGMENTS;
+	if (self->lock_span == 0)
+		self->lock_span = 1;
+	self->threaded = threaded;
 	
 	return 0;
 }
@@ -149,57 +1232,177 @@ static int apa102_init (apa102Object *self, PyObject *args, PyObject *keywds){
 
 static void apa102_dealloc(apa102Object *self)
 {
-	PyMem_Free((void*)self->leds);
-	if (self->spi_write != NULL)
-		Py_XDECREF(self->spi_write);
+	net_stop_internal(self);
+	async_stop_internal(self);
+	shm_detach_internal(self);
+	record_stop_internal(self);
+	layers_free_internal(self);
+	palette_free_internal(self);
+	render_stop_internal(self);
+	pthread_mutex_destroy(&self->async_lock);
+	pthread_cond_destroy(&self->async_cond);
+	for (int i = 0; i < LOCK_SEGMENTS; i++)
+		pthread_mutex_destroy(&self->segment_locks[i]);
+	pthread_mutex_destroy(&self->dirty_lock);
+	pthread_mutex_destroy(&self->show_lock);
+	pthread_mutex_destroy(&self->render_busy);
+	pthread_mutex_destroy(&self->render_lock);
+	pthread_cond_destroy(&self->render_cond);
+	pthread_cond_destroy(&self->render_done);
+	Py_XDECREF(self->async_error);
+	Py_XDECREF(self->frame_list);
+	PyMem_Free((void*)self->frame);
+	PyMem_Free((void*)self->wire);
+	Py_XDECREF(self->spi_write);
+	Py_XDECREF(self->layout);
+	Py_XDECREF(self->net_error);
+	close_fd_internal(self);
 	Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
 
+//METH_FASTCALL helpers: the usual positional call is read straight from the argument array,
+//anything with keywords is turned back into a tuple and dict for PyArg_ParseTupleAndKeywords
+int fast_int(PyObject *obj, int *value) {
+	long value_long = PyLong_AsLong(obj);
+	if (value_long == -1 && PyErr_Occurred())
+		return -1;
+	if (value_long > INT_MAX || value_long < INT_MIN) {
+		PyErr_SetString(PyExc_OverflowError, "signed integer is out of range");
+		return -1;
+	}
+	*value = (int)value_long;
+	return 0;
+}
+int fast_byte(PyObject *obj, unsigned char *value) {
+	long value_long = PyLong_AsLong(obj);
+	if (value_long == -1 && PyErr_Occurred())
+		return -1;
+	if (value_long < 0 || value_long > 255) {
+		PyErr_SetString(PyExc_OverflowError, "unsigned byte integer is out of range");
+		return -1;
+	}
+	*value = (unsigned char)value_long;
+	return 0;
+}
+//the caller has to release tuple and dict (which may be NULL)
+int fastcall_to_varargs(PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames, PyObject **tuple, PyObject **dict) {
+	*dict = NULL;
+	*tuple = PyTuple_New(nargs);
+	if (*tuple == NULL)
+		return -1;
+	for (Py_ssize_t i = 0; i < nargs; i++) {
+		Py_INCREF(args[i]);
+		PyTuple_SET_ITEM(*tuple, i, args[i]);
+	}
+	if (kwnames == NULL)
+		return 0;
+	*dict = PyDict_New();
+	if (*dict == NULL)
+		return -1;
+	for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(kwnames); i++) {
+		if (PyDict_SetItem(*dict, PyTuple_GET_ITEM(kwnames, i), args[nargs+i]) < 0)
+			return -1;
+	}
+	return 0;
+}
+
 PyDoc_STRVAR(apa102_set_pixel_doc,
 	"set_pixel(led_num, red, green, blue, [brightness=31])\n\n"
 	"sets the pixel at led_num to show the given red, green, and blue values (from 0 to 255 inclusive)\n"
 	"optional- include a brightness to display the pixels at (from 0 to 31 inclusive)");
-static PyObject * apa102_set_pixel(apa102Object *self, PyObject *args, PyObject *keywds)
+static PyObject * apa102_set_pixel(apa102Object *self, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames)
 {
-	
-	static char *kwlist[] = {"led_num", "red", "green", "blue", "brightness", NULL};
-	static const char *types = "ibbb|b:set_pixel";	
 	int led_num;
 	unsigned char r, g, b, led_brightness = MAX_BRIGHTNESS;
-	PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &led_num, &r, &g, &b, &led_brightness);
+	if (kwnames == NULL && (nargs == 4 || nargs == 5)) {
+		if (fast_int(args[0], &led_num) < 0 || fast_byte(args[1], &r) < 0 || fast_byte(args[2], &g) < 0 || fast_byte(args[3], &b) < 0)
+			return NULL;
+		if (nargs == 5 && fast_byte(args[4], &led_brightness) < 0)
+			return NULL;
+	}
+	else {
+		static char *kwlist[] = {"led_num", "red", "green", "blue", "brightness", NULL};
+		static const char *types = "ibbb|b:set_pixel";
+		PyObject *tuple, *dict;
+		int ok = fastcall_to_varargs(args, nargs, kwnames, &tuple, &dict) == 0
+			&& PyArg_ParseTupleAndKeywords(tuple, dict, types, kwlist, &led_num, &r, &g, &b, &led_brightness);
+		Py_XDECREF(tuple);
+		Py_XDECREF(dict);
+		if (!ok)
+			return NULL;
+	}
+	count_set_call(self);
 	
 	//if led_num is out of range, do nothing
-	if (led_num < self->num_led && led_num >= 0)
+	if (led_num < self->num_led && led_num >= 0) {
+		lock_range(self, led_num, led_num+1);
 		set_pixel_internal(self, led_num, r, g, b, get_bright_byte(self, led_brightness));
+		unlock_range(self, led_num, led_num+1);
+	}
 	Py_RETURN_NONE;
 }
 PyDoc_STRVAR(apa102_set_pixel_rgb_doc,
 	"set_pixel(led_num, rgb_color, [brightness=31])\n\n"
 	"sets the pixel at led_num to show the given rgb value in the format 0xRRGGBB\n"
 	"optional- include a brightness to display the pixels at (from 0 to 31 inclusive)");
-static PyObject * apa102_set_pixel_rgb(apa102Object *self, PyObject *args, PyObject *keywds)
+static PyObject * apa102_set_pixel_rgb(apa102Object *self, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames)
 {
-	
-	static char *kwlist[] = {"led_num", "rgb_color", "brightness", NULL};
-	static const char *types = "ii|b:set_pixel_rgb";	
 	int led_num, rgb;
 	unsigned char r, g, b, led_brightness = MAX_BRIGHTNESS;
-	PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &led_num, &rgb, &led_brightness);
+	if (kwnames == NULL && (nargs == 2 || nargs == 3)) {
+		if (fast_int(args[0], &led_num) < 0 || fast_int(args[1], &rgb) < 0)
+			return NULL;
+		if (nargs == 3 && fast_byte(args[2], &led_brightness) < 0)
+			return NULL;
+	}
+	else {
+		static char *kwlist[] = {"led_num", "rgb_color", "brightness", NULL};
+		static const char *types = "ii|b:set_pixel_rgb";
+		PyObject *tuple, *dict;
+		int ok = fastcall_to_varargs(args, nargs, kwnames, &tuple, &dict) == 0
+			&& PyArg_ParseTupleAndKeywords(tuple, dict, types, kwlist, &led_num, &rgb, &led_brightness);
+		Py_XDECREF(tuple);
+		Py_XDECREF(dict);
+		if (!ok)
+			return NULL;
+	}
+	count_set_call(self);
 	
 	get_rgb_internal(rgb, &r, &g, &b);
 	//if led_num is out of range, do nothing
-	if (led_num < self->num_led && led_num >= 0)
+	if (led_num < self->num_led && led_num >= 0) {
+		lock_range(self, led_num, led_num+1);
 		set_pixel_internal(self, led_num, r, g, b, get_bright_byte(self, led_brightness));
+		unlock_range(self, led_num, led_num+1);
+	}
 	Py_RETURN_NONE;
 }
 
+//render job for set_range_internal, color is the brightness byte then red, green, and blue
+static void fill_slice(apa102Object *self, const void *arg, Py_ssize_t start, Py_ssize_t end) {
+	const byte *color = (const byte*)arg;
+	byte *ptr = led_ptr(self, start);
+	byte *wrap = self->leds + self->num_led_array;
+	for (Py_ssize_t i = start; i < end; i++) {
+		write_led(self, ptr, color[1], color[2], color[3], color[0]);
+		ptr += BYTES_PER_LED;
+		if (ptr == wrap)
+			ptr = self->leds;
+	}
+}
 //to prevent repeating code:
 void set_range_internal(apa102Object *self, int start, int end, byte r, byte g, byte b, byte led_brightness) {
 	byte bright_byte = get_bright_byte(self, led_brightness);
-	for (int i = start; i < end; i++) {
-		set_pixel_internal(self, i, r, g, b, bright_byte);
+	if (start >= end) {
+		mark_dirty(self, start, end);
+		return;
 	}
+	byte color[4] = {bright_byte, r, g, b};
+	PyThreadState *save = lock_pixels(self, start, end, end - start);
+	mark_dirty(self, start, end);
+	render_range(self, fill_slice, color, start, end);
+	unlock_pixels(self, start, end, save);
 }
 
 PyDoc_STRVAR(apa102_set_range_doc,
@@ -213,7 +1416,9 @@ static PyObject * apa102_set_range(apa102Object *self, PyObject *args, PyObject
 	static const char *types = "iibbb|b:set_range";	
 	int start, end;
 	unsigned char r, g, b, led_brightness = MAX_BRIGHTNESS;
-	PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &start, &end, &r, &g, &b, &led_brightness);
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &start, &end, &r, &g, &b, &led_brightness))
+		return NULL;
+	count_set_call(self);
 	
 	//if start or end is out of range or start is before end. do nothing
 	if (start < 0 || end >= self->num_led || start > end)
@@ -234,7 +1439,9 @@ static PyObject * apa102_set_range_rgb(apa102Object *self, PyObject *args, PyObj
 	static const char *types = "iii|b:set_range_rgb";	
 	int start, end, rgb;
 	unsigned char r, g, b, led_brightness = MAX_BRIGHTNESS;
-	PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &start, &end, &rgb, &led_brightness);
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &start, &end, &rgb, &led_brightness))
+		return NULL;
+	count_set_call(self);
 	
 	//if start or end is out of range or start is before end. do nothing
 	if (start < 0 || end >= self->num_led || start > end)
@@ -257,7 +1464,9 @@ static PyObject * apa102_set_all(apa102Object *self, PyObject *args, PyObject *k
 	static char *kwlist[] = {"red", "green", "blue", "brightness", NULL};
 	static const char *types = "bbb|b:set_all";	
 	unsigned char r, g, b, led_brightness = MAX_BRIGHTNESS;
-	PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &r, &g, &b, &led_brightness);
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &r, &g, &b, &led_brightness))
+		return NULL;
+	count_set_call(self);
 	
 	set_range_internal(self, 0, self->num_led, r, g, b, led_brightness);
 	
@@ -274,7 +1483,9 @@ static PyObject * apa102_set_all_rgb(apa102Object *self, PyObject *args, PyObjec
 	static const char *types = "i|b:set_all_rgb";	
 	int rgb;
 	unsigned char r, g, b, led_brightness = MAX_BRIGHTNESS;
-	PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &rgb, &led_brightness);
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &rgb, &led_brightness))
+		return NULL;
+	count_set_call(self);
 	
 	get_rgb_internal(rgb, &r, &g, &b);
 	
@@ -283,109 +1494,2783 @@ static PyObject * apa102_set_all_rgb(apa102Object *self, PyObject *args, PyObjec
 	Py_RETURN_NONE;
 }
 
-PyDoc_STRVAR(apa102_clear_strip_doc,
-	"clear_strip()\n\n"
-	"sets all pixels to black");
-static PyObject * apa102_clear_strip(apa102Object *self, PyObject *args)
+PyDoc_STRVAR(apa102_set_pixels_doc,
+	"set_pixels(buffer, [start=0], [brightness=31], [layout=\"rgb\"])\n\n"
+	"sets the pixels from start on to the colors in buffer, any contiguous buffer (bytes, bytearray, numpy array...) of packed pixels\n"
+	"layout is the order of the bytes in each pixel, 3 characters for RGB data or 4 for RGBA (the alpha byte is skipped)\n"
+	"pixels past the end of the strip are ignored\n"
+	"optional- include a brightness to display the pixels at (from 0 to 31 inclusive)");
+static PyObject * apa102_set_pixels(apa102Object *self, PyObject *args, PyObject *keywds)
 {
-	set_range_internal(self, 0, self->num_led, 0, 0, 0, MAX_BRIGHTNESS);
-		
+	static char *kwlist[] = {"buffer", "start", "brightness", "layout", NULL};
+	static const char *types = "y*|ibs:set_pixels";
+	Py_buffer buffer;
+	int start = 0;
+	unsigned char led_brightness = MAX_BRIGHTNESS;
+	const char *layout = "rgb";
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &buffer, &start, &led_brightness, &layout))
+		return NULL;
+	count_set_call(self);
+	
+	byte src_off[3];
+	int stride = parse_layout(layout, src_off);
+	if (stride == 0) {
+		PyBuffer_Release(&buffer);
+		PyErr_SetString(PyExc_ValueError, "layout must contain r, g, and b once each and at most one a");
+		return NULL;
+	}
+	if (buffer.len % stride != 0) {
+		PyBuffer_Release(&buffer);
+		PyErr_Format(PyExc_ValueError, "buffer length must be a multiple of %d", stride);
+		return NULL;
+	}
+	
+	//if start is out of range, do nothing
+	if (start >= 0 && start < self->num_led) {
+		Py_ssize_t count = buffer.len / stride;
+		if (count > self->num_led - start)
+			count = self->num_led - start;
+		byte bright_byte = get_bright_byte(self, led_brightness);
+		PyThreadState *save = lock_pixels(self, start, start+count, count);
+		//the range can wrap around the end of the ring
+		Py_ssize_t first = start + self->head;
+		if (first >= self->num_led)
+			first -= self->num_led;
+		Py_ssize_t first_count = self->num_led - first;
+		if (first_count > count)
+			first_count = count;
+		swizzle_kernel(self->leds + first*BYTES_PER_LED, (const byte*)buffer.buf, first_count, stride, src_off, self->rgb, bright_byte);
+		swizzle_kernel(self->leds, (const byte*)buffer.buf + first_count*stride, count - first_count, stride, src_off, self->rgb, bright_byte);
+		mark_dirty(self, start, start+count);
+		unlock_pixels(self, start, start+count, save);
+	}
+	PyBuffer_Release(&buffer);
 	Py_RETURN_NONE;
 }
 
+//reads the i-th led number from a buffer get_indices returned, which doesn't have to be 4 byte aligned (a slice of bytes isn't)
+static inline uint32_t index_at(const byte *led_nums, Py_ssize_t i) {
+	uint32_t led_num;
+	memcpy(&led_num, led_nums + i*4, sizeof(led_num));
+	return led_num;
+}
+//gets a buffer of 32 bit led numbers, returns how many or -1 with an exception set
+Py_ssize_t get_indices(PyObject *obj, Py_buffer *buffer) {
+	if (PyObject_GetBuffer(obj, buffer, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) < 0)
+		return -1;
+	//raw bytes are read as native uint32s, anything with a format has to have 4 byte integers
+	const char *format = buffer->format;
+	if (format != NULL && (*format == '@' || *format == '=' || *format == '<' || *format == '>' || *format == '!'))
+		format++;
+	int raw = (format == NULL || strcmp(format, "B") == 0 || strcmp(format, "b") == 0 || strcmp(format, "c") == 0);
+	if ((!raw && (buffer->itemsize != 4 || strchr("IiLl", *format) == NULL)) || buffer->len % 4 != 0) {
+		PyBuffer_Release(buffer);
+		PyErr_SetString(PyExc_TypeError, "indices must be a buffer of 32 bit integers (array('I'), a uint32 numpy array, or bytes)");
+		return -1;
+	}
+	return buffer->len / 4;
+}
 
-PyDoc_STRVAR(apa102_show_doc,
-	"show()\n\n"
-	"sends the data to the pixels to display");
-static PyObject * apa102_show(apa102Object *self, PyObject *args)
+PyDoc_STRVAR(apa102_set_pixels_at_doc,
+	"set_pixels_at(indices, colors, [brightness=31], [layout=\"rgb\"])\n\n"
+	"sets the pixel at each led number in indices, a buffer of 32 bit integers (like array('I')), to the matching color in colors,\n"
+	"a buffer of packed pixels like set_pixels takes. led numbers out of range are skipped\n"
+	"optional- include a brightness to display the pixels at (from 0 to 31 inclusive), or a buffer with one brightness byte per pixel");
+static PyObject * apa102_set_pixels_at(apa102Object *self, PyObject *args, PyObject *keywds)
 {
-	if (self->spi_write == NULL)
-		Py_RETURN_NONE;
+	static char *kwlist[] = {"indices", "colors", "brightness", "layout", NULL};
+	static const char *types = "Oy*|Os:set_pixels_at";
+	PyObject *indices_obj, *brightness_obj = NULL;
+	Py_buffer colors, indices, brightness;
+	const char *layout = "rgb";
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &indices_obj, &colors, &brightness_obj, &layout))
+		return NULL;
+	count_set_call(self);
 	
-	Py_ssize_t end_bytes = (self->num_led + 15) / 16;
-	PyObject *list = PyList_New(self->num_led_array + 4 + end_bytes);
-
-	//first send out 4 0-bytes to tell the first pixel it's color will be sent next
-	PyObject *zero_obj = PyLong_FromLong(0l);
-	for (Py_ssize_t i = 0; i < 4; i++) {
-		//set item takes ownership of the object
-		//since I'm using it multiple times, I must increase the ref count each time
-		Py_INCREF(zero_obj);
-		PyList_SetItem(list, i, zero_obj);
-		
+	PyObject *result = NULL;
+	brightness.obj = NULL;
+	brightness.buf = NULL;
+	Py_ssize_t count = get_indices(indices_obj, &indices);
+	if (count < 0) {
+		PyBuffer_Release(&colors);
+		return NULL;
 	}
-	
-	PyObject *loopO;
-	for (Py_ssize_t i = 0; i<self->num_led_array; i++) {
-		loopO = PyLong_FromLong((long)(*(self->leds+i)));
-		PyList_SetItem(list, i+4, loopO);
+	byte src_off[3];
+	int stride = parse_layout(layout, src_off);
+	unsigned char led_brightness = MAX_BRIGHTNESS;
+	if (stride == 0) {
+		PyErr_SetString(PyExc_ValueError, "layout must contain r, g, and b once each and at most one a");
+		goto done;
 	}
-	
-	for (Py_ssize_t i = self->num_led_array+4; i < self->num_led_array+4+end_bytes; i++) {
-		Py_INCREF(zero_obj);
-		PyList_SetItem(list, i, zero_obj);
+	if (colors.len != count*stride) {
+		PyErr_Format(PyExc_ValueError, "colors must have %d bytes for each of the %zd indices", stride, count);
+		goto done;
+	}
+	if (brightness_obj != NULL && PyLong_Check(brightness_obj)) {
+		if (fast_byte(brightness_obj, &led_brightness) < 0)
+			goto done;
+	}
+	else if (brightness_obj != NULL && brightness_obj != Py_None) {
+		if (PyObject_GetBuffer(brightness_obj, &brightness, PyBUF_SIMPLE) < 0)
+			goto done;
+		if (brightness.len != count) {
+			PyErr_Format(PyExc_ValueError, "brightness must have 1 byte for each of the %zd indices", count);
+			goto done;
+		}
 	}
-	//there is one more ref count than it needs before this
-	Py_DECREF(zero_obj);
-	
-	
-	PyObject *tuple = PyTuple_Pack(1, list);
-	PyObject *result = PyObject_CallObject(self->spi_write, tuple);
-	if (result == NULL)
-		return NULL;
-	Py_DECREF(result);
-	Py_DECREF(tuple);
-	Py_DECREF(list);
-	
 	
+	const byte *led_nums = (const byte*)indices.buf;
+	const byte *src = (const byte*)colors.buf;
+	const byte *bright = (const byte*)brightness.buf;
+	byte bright_byte = get_bright_byte(self, led_brightness);
+	Py_ssize_t dirty_start = self->num_led, dirty_end = 0;
+	//the indices can be anywhere, so every segment is locked
+	PyThreadState *save = lock_pixels(self, 0, self->num_led, count);
+	for (Py_ssize_t i = 0; i < count; i++, src += stride) {
+		uint32_t led_num = index_at(led_nums, i);
+		if (led_num >= (uint32_t)self->num_led)
+			continue;
+		if (bright != NULL)
+			bright_byte = get_bright_byte(self, bright[i]);
+		write_pixel_internal(self, led_num, *(src + src_off[RED]), *(src + src_off[GRN]), *(src + src_off[BLU]), bright_byte);
+		if (led_num < dirty_start)
+			dirty_start = led_num;
+		if (led_num >= dirty_end)
+			dirty_end = led_num + 1;
+	}
+	if (dirty_start < dirty_end)
+		mark_dirty(self, dirty_start, dirty_end);
+	unlock_pixels(self, 0, self->num_led, save);
+	result = Py_None;
+	Py_INCREF(result);
+done:
+	if (brightness.obj != NULL)
+		PyBuffer_Release(&brightness);
+	PyBuffer_Release(&indices);
+	PyBuffer_Release(&colors);
+	return result;
+}
 
-	Py_RETURN_NONE;
+PyDoc_STRVAR(apa102_get_pixels_at_doc,
+	"get_pixels_at(indices, [layout=\"rgb\"])\n\n"
+	"returns the colors of the pixels at each led number in indices (a buffer of 32 bit integers like array('I'))\n"
+	"as bytes of packed pixels in the order given by layout, raises IndexError if a led number is out of range");
+static PyObject * apa102_get_pixels_at(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"indices", "layout", NULL};
+	static const char *types = "O|s:get_pixels_at";
+	PyObject *indices_obj;
+	Py_buffer indices;
+	const char *layout = "rgb";
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &indices_obj, &layout))
+		return NULL;
+	byte dst_off[3];
+	int stride = parse_layout(layout, dst_off);
+	if (stride == 0) {
+		PyErr_SetString(PyExc_ValueError, "layout must contain r, g, and b once each and at most one a");
+		return NULL;
+	}
+	Py_ssize_t count = get_indices(indices_obj, &indices);
+	if (count < 0)
+		return NULL;
 	
+	PyObject *result = PyBytes_FromStringAndSize(NULL, count*stride);
+	if (result == NULL) {
+		PyBuffer_Release(&indices);
+		return NULL;
+	}
+	byte *dst = (byte*)PyBytes_AS_STRING(result);
+	memset(dst, 0, count*stride);
+	const byte *led_nums = (const byte*)indices.buf;
+	Py_ssize_t bad = -1;
+	PyThreadState *save = lock_pixels(self, 0, self->num_led, count);
+	for (Py_ssize_t i = 0; i < count; i++, dst += stride) {
+		uint32_t led_num = index_at(led_nums, i);
+		if (led_num >= (uint32_t)self->num_led) {
+			bad = i;
+			break;
+		}
+		const byte *src = led_ptr(self, led_num);
+		*(dst + dst_off[RED]) = *(src + self->rgb[RED]);
+		*(dst + dst_off[GRN]) = *(src + self->rgb[GRN]);
+		*(dst + dst_off[BLU]) = *(src + self->rgb[BLU]);
+	}
+	unlock_pixels(self, 0, self->num_led, save);
+	if (bad >= 0) {
+		PyErr_Format(PyExc_IndexError, "led number %u at position %zd is out of range", index_at(led_nums, bad), bad);
+		Py_CLEAR(result);
+	}
+	PyBuffer_Release(&indices);
+	return result;
 }
 
-static const char HEX_CHARS[] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
-static const char NUMBER_SIGN = '#', NULL_CHAR = '\0';
-
-PyDoc_STRVAR(apa102_get_pixel_color_str_doc,
-	"get_pixel_color_str(led_num)\n\n"
-	"returns the color of the requested pixel as a string in the format \"RRGGBB\"\n"
-	"or None if led_num is out of range");
-static PyObject * apa102_get_pixel_color_str(apa102Object *self, PyObject *args) {
-	int led_num;
-	static const char *types = "i:get_pixel_color_str";
-	PyArg_ParseTuple(args, types, &led_num);
-	
-	if(led_num < 0 || led_num > self->num_led)
-		Py_RETURN_NONE;
-	
-	led_num *= BYTES_PER_LED;
-	char str[8];
-	str[0] = NUMBER_SIGN;
-	str[7] = NULL_CHAR;
-	byte b = 0;
-	for (int i = 0; i < BYTES_PER_LED-1; i++) {
-		b = *(self->leds+(led_num)+self->rgb[i]);
-		str[i*2+2] = HEX_CHARS[b&15];
-		str[i*2+1] = HEX_CHARS[(b>>4)&15];
+//gets a buffer of HSV pixels, bytes or 16 bit integers. returns how many pixels and sets wide, or -1 with an exception set
+Py_ssize_t get_hsv(PyObject *obj, Py_buffer *buffer, int *wide) {
+	if (PyObject_GetBuffer(obj, buffer, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) < 0)
+		return -1;
+	const char *format = buffer->format;
+	if (format != NULL && (*format == '@' || *format == '=' || *format == '<' || *format == '>' || *format == '!'))
+		format++;
+	*wide = (format != NULL && buffer->itemsize == 2 && (*format == 'H' || *format == 'h'));
+	int raw = (format == NULL || strcmp(format, "B") == 0 || strcmp(format, "b") == 0 || strcmp(format, "c") == 0);
+	int pixel_len = *wide ? 6 : 3;
+	if ((!raw && !*wide) || buffer->len % pixel_len != 0) {
+		PyBuffer_Release(buffer);
+		PyErr_SetString(PyExc_TypeError, "buffer must hold h, s, v for every pixel as bytes or as 16 bit integers (array('H'), a uint16 numpy array)");
+		return -1;
 	}
-	PyObject* returnObj =  PyUnicode_FromString(&str[0]);
-	return returnObj;
+	return buffer->len / pixel_len;
 }
 
-PyDoc_STRVAR(apa102_get_pixel_color_rgb_doc,
+PyDoc_STRVAR(apa102_set_pixels_hsv_doc,
+	"set_pixels_hsv(buffer, [start=0], [brightness=31])\n\n"
+	"sets the pixels from start on to the colors in buffer, packed hue, saturation, value for every pixel\n"
+	"a buffer of bytes (bytes, bytearray, a uint8 numpy array...) has 8 bits per channel, with the hue going once around the circle from 0 to 255\n"
+	"a buffer of 16 bit integers (array('H'), a uint16 numpy array) has 16 bits per channel, with the hue going around from 0 to 65535\n"
+	"pixels past the end of the strip are ignored\n"
+	"optional- include a brightness to display the pixels at (from 0 to 31 inclusive)");
+static PyObject * apa102_set_pixels_hsv(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"buffer", "start", "brightness", NULL};
+	static const char *types = "O|ib:set_pixels_hsv";
+	PyObject *buffer_obj;
+	Py_buffer buffer;
+	int start = 0, wide;
+	unsigned char led_brightness = MAX_BRIGHTNESS;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &buffer_obj, &start, &led_brightness))
+		return NULL;
+	count_set_call(self);
+	Py_ssize_t count = get_hsv(buffer_obj, &buffer, &wide);
+	if (count < 0)
+		return NULL;
+	
+	//if start is out of range, do nothing
+	if (start >= 0 && start < self->num_led) {
+		if (count > self->num_led - start)
+			count = self->num_led - start;
+		static const byte rgb_off[3] = {0, 1, 2};
+		byte bright_byte = get_bright_byte(self, led_brightness);
+		byte rgb[HSV_BLOCK*3];
+		const byte *src = (const byte*)buffer.buf;
+		Py_ssize_t pixel_len = wide ? 6 : 3;
+		PyThreadState *save = lock_pixels(self, start, start+count, count);
+		//a block at a time so the colors are still in cache when they are put in the strip's order
+		for (Py_ssize_t i = 0; i < count; i += HSV_BLOCK) {
+			Py_ssize_t block = (count - i < HSV_BLOCK) ? count - i : HSV_BLOCK;
+			hsv_to_rgb_internal(rgb, src + i*pixel_len, block, wide);
+			//the block can wrap around the end of the ring
+			for (Py_ssize_t done = 0; done < block;) {
+				Py_ssize_t index = start + i + done + self->head;
+				if (index >= self->num_led)
+					index -= self->num_led;
+				Py_ssize_t piece = self->num_led - index;
+				if (piece > block - done)
+					piece = block - done;
+				swizzle_kernel(self->leds + index*BYTES_PER_LED, rgb + done*3, piece, 3, rgb_off, self->rgb, bright_byte);
+				done += piece;
+			}
+		}
+		mark_dirty(self, start, start+count);
+		unlock_pixels(self, start, start+count, save);
+	}
+	PyBuffer_Release(&buffer);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(apa102_hsv_to_rgb_doc,
+	"hsv_to_rgb(buffer)\n\n"
+	"converts a buffer of packed hue, saturation, value pixels (8 or 16 bits per channel, like set_pixels_hsv takes)\n"
+	"to packed red, green, blue bytes, 3 for every pixel, that set_pixels takes");
+static PyObject * apa102_hsv_to_rgb(PyObject *self, PyObject *buffer_obj)
+{
+	Py_buffer buffer;
+	int wide;
+	Py_ssize_t count = get_hsv(buffer_obj, &buffer, &wide);
+	if (count < 0)
+		return NULL;
+	PyObject *result = PyBytes_FromStringAndSize(NULL, count*3);
+	if (result != NULL) {
+		Py_BEGIN_ALLOW_THREADS
+		hsv_to_rgb_internal((byte*)PyBytes_AS_STRING(result), buffer.buf, count, wide);
+		Py_END_ALLOW_THREADS
+	}
+	PyBuffer_Release(&buffer);
+	return result;
+}
+
+//indexed mode: set_palette() gives every led a one byte index into a palette of up to 256 colors.
+//show() looks the changed leds up in the palette as it gets the frame ready, so changing the palette only costs O(palette)
+#define PALETTE_SIZE 256
+
+void palette_free_internal(apa102Object *self) {
+	PyMem_Free(self->indices);
+	PyMem_Free(self->palette);
+	self->indices = NULL;
+	self->palette = NULL;
+	self->palette_len = 0;
+}
+
+PyDoc_STRVAR(apa102_set_palette_doc,
+	"set_palette(colors, [brightness=31], [layout=\"rgb\"])\n\n"
+	"switches the strip to indexed mode, where each led shows the palette color its index (set with set_indices) points to\n"
+	"colors is a buffer of 1 to 256 packed pixels like set_pixels takes, indices past the end of the palette are black\n"
+	"the first call sets every index to 0. after that the palette can be changed as often as needed without touching the indices\n"
+	"in indexed mode the colors come from the palette every time show() runs, so the other set functions only last until then\n"
+	"optional- include a brightness to display the palette at (from 0 to 31 inclusive)\n"
+	"colors can be None to go back to setting the pixels themselves");
+static PyObject * apa102_set_palette(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"colors", "brightness", "layout", NULL};
+	static const char *types = "O|bs:set_palette";
+	PyObject *colors_obj;
+	unsigned char led_brightness = MAX_BRIGHTNESS;
+	const char *layout = "rgb";
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &colors_obj, &led_brightness, &layout))
+		return NULL;
+	if (self->leds == NULL) {
+		PyErr_SetString(PyExc_RuntimeError, "APA102 object is not initialized");
+		return NULL;
+	}
+	if (colors_obj == Py_None) {
+		lock_range(self, 0, self->num_led);
+		palette_free_internal(self);
+		unlock_range(self, 0, self->num_led);
+		Py_RETURN_NONE;
+	}
+	byte src_off[3];
+	int stride = parse_layout(layout, src_off);
+	if (stride == 0) {
+		PyErr_SetString(PyExc_ValueError, "layout must contain r, g, and b once each and at most one a");
+		return NULL;
+	}
+	Py_buffer colors;
+	if (PyObject_GetBuffer(colors_obj, &colors, PyBUF_C_CONTIGUOUS) < 0)
+		return NULL;
+	Py_ssize_t count = colors.len / stride;
+	if (colors.len % stride != 0 || count < 1 || count > PALETTE_SIZE) {
+		PyBuffer_Release(&colors);
+		PyErr_Format(PyExc_ValueError, "colors must be 1 to %d pixels of %d bytes", PALETTE_SIZE, stride);
+		return NULL;
+	}
+	
+	PyObject *result = NULL;
+	lock_range(self, 0, self->num_led);
+	if (self->palette == NULL) {
+		self->indices = PyMem_Calloc(self->num_led, sizeof(byte));
+		self->palette = PyMem_Calloc(PALETTE_SIZE, sizeof(uint32_t));
+		if (self->indices == NULL || self->palette == NULL) {
+			palette_free_internal(self);
+			PyErr_NoMemory();
+			goto done;
+		}
+	}
+	//the entries are kept the way leds stores pixels, so looking one up is a 4 byte copy
+	byte bright_byte = get_bright_byte(self, led_brightness);
+	const byte *src = (const byte*)colors.buf;
+	//entries past the colors given are black
+	for (Py_ssize_t i = 0; i < PALETTE_SIZE; i++) {
+		byte *entry = (byte*)&self->palette[i];
+		memset(entry, 0, BYTES_PER_LED);
+		*(entry) = bright_byte;
+		if (i < count) {
+			*(entry + self->rgb[RED]) = *(src + src_off[RED]);
+			*(entry + self->rgb[GRN]) = *(src + src_off[GRN]);
+			*(entry + self->rgb[BLU]) = *(src + src_off[BLU]);
+			src += stride;
+		}
+	}
+	self->palette_len = count;
+	mark_dirty(self, 0, self->num_led);
+	result = Py_None;
+done:
+	unlock_range(self, 0, self->num_led);
+	PyBuffer_Release(&colors);
+	Py_XINCREF(result);
+	return result;
+}
+
+PyDoc_STRVAR(apa102_set_indices_doc,
+	"set_indices(buffer, [start=0])\n\n"
+	"sets the palette index of the leds from start on to the bytes in buffer (bytes, bytearray, a uint8 numpy array...)\n"
+	"indices past the end of the strip are ignored, set_palette has to be called first");
+static PyObject * apa102_set_indices(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"buffer", "start", NULL};
+	static const char *types = "y*|i:set_indices";
+	Py_buffer buffer;
+	int start = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &buffer, &start))
+		return NULL;
+	if (self->palette == NULL) {
+		PyBuffer_Release(&buffer);
+		PyErr_SetString(PyExc_RuntimeError, "set_palette has to be called before set_indices");
+		return NULL;
+	}
+	count_set_call(self);
+	//if start is out of range, do nothing
+	if (start >= 0 && start < self->num_led) {
+		Py_ssize_t count = buffer.len;
+		if (count > self->num_led - start)
+			count = self->num_led - start;
+		PyThreadState *save = lock_pixels(self, start, start+count, count);
+		memcpy(self->indices + start, buffer.buf, count);
+		mark_dirty(self, start, start+count);
+		unlock_pixels(self, start, start+count, save);
+	}
+	PyBuffer_Release(&buffer);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(apa102_rotate_palette_doc,
+	"rotate_palette([positions=1])\n\n"
+	"moves every color of the palette set by set_palette up by the given amount, the last ones wrap around to the start\n"
+	"positions can be negative to rotate backwards. this cycles the colors of the whole strip without touching the indices");
+static PyObject * apa102_rotate_palette(apa102Object *self, PyObject *args)
+{
+	static const char *types = "|i:rotate_palette";
+	int signed_pos = 1;
+	if (!PyArg_ParseTuple(args, types, &signed_pos))
+		return NULL;
+	if (self->palette == NULL) {
+		PyErr_SetString(PyExc_RuntimeError, "set_palette has to be called before rotate_palette");
+		return NULL;
+	}
+	Py_ssize_t pos = signed_pos % self->palette_len;
+	if (pos < 0)
+		pos += self->palette_len;
+	if (pos == 0)
+		Py_RETURN_NONE;
+	uint32_t rotated[PALETTE_SIZE];
+	lock_range(self, 0, self->num_led);
+	memcpy(rotated + pos, self->palette, (self->palette_len - pos)*sizeof(uint32_t));
+	memcpy(rotated, self->palette + self->palette_len - pos, pos*sizeof(uint32_t));
+	memcpy(self->palette, rotated, self->palette_len*sizeof(uint32_t));
+	mark_dirty(self, 0, self->num_led);
+	unlock_range(self, 0, self->num_led);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(apa102_clear_strip_doc,
+	"clear_strip()\n\n"
+	"sets all pixels to black, on a layer other than 0 they become see through");
+static PyObject * apa102_clear_strip(apa102Object *self, PyObject *args)
+{
+	set_range_internal(self, 0, self->num_led, 0, 0, 0, (self->current_layer > 0) ? 0 : MAX_BRIGHTNESS);
+		
+	Py_RETURN_NONE;
+}
+
+
+//only used when legacy_list is set, builds the frame the way show() used to
+static PyObject * frame_as_list(const byte *data, Py_ssize_t len) {
+	PyObject *list = PyList_New(len);
+	if (list == NULL)
+		return NULL;
+	
+	for (Py_ssize_t i = 0; i < len; i++) {
+		//values from 0 to 255 are cached by python so this doesn't create any new objects
+		PyList_SET_ITEM(list, i, PyLong_FromLong((long)(*(data+i))));
+	}
+	return list;
+}
+
+//the frame in the order it is sent, returns how many segments it takes
+//while led 0 is stored first it is the frame buffer as is, otherwise leds are sent in two parts
+int frame_segments(apa102Object *self, segment *segs) {
+	if (self->head == 0) {
+		segs[0].data = self->frame;
+		segs[0].len = self->frame_len;
+		return 1;
+	}
+	Py_ssize_t head_bytes = self->head*BYTES_PER_LED;
+	segs[0].data = self->frame;
+	segs[0].len = START_FRAME_BYTES;
+	segs[1].data = self->leds + head_bytes;
+	segs[1].len = self->num_led_array - head_bytes;
+	segs[2].data = self->leds;
+	segs[2].len = head_bytes;
+	segs[3].data = self->leds + self->num_led_array;
+	segs[3].len = self->frame_len - START_FRAME_BYTES - self->num_led_array;
+	return 4;
+}
+
+//the scratch buffer for putting frames together, allocated the first time it is needed
+byte * wire_buffer(apa102Object *self) {
+	if (self->wire == NULL) {
+		self->wire = PyMem_Calloc(self->frame_len, sizeof(byte));
+		if (self->wire == NULL)
+			PyErr_NoMemory();
+	}
+	return self->wire;
+}
+
+//set when write_callback gets the frame in more than one call
+static inline int is_chunked(apa102Object *self) {
+	return self->chunk_size > 0 && self->frame_len > self->chunk_size;
+}
+
+//write_callback's memoryview is made from one of these, so any view the callback keeps is counted in the strip's
+//frame_exports and keeps the strip, and with it the memory the view points at, from going away
+typedef struct {
+	PyObject_HEAD
+	apa102Object *strip;
+	const byte *data;
+	Py_ssize_t len;
+} frameviewObject;
+
+static PyTypeObject frameview_Type;
+
+static int frameview_getbuffer(frameviewObject *self, Py_buffer *view, int flags) {
+	if (PyBuffer_FillInfo(view, (PyObject*)self, (void*)self->data, self->len, 1, flags) < 0)
+		return -1;
+	self->strip->frame_exports++;
+	return 0;
+}
+static void frameview_releasebuffer(frameviewObject *self, Py_buffer *view) {
+	self->strip->frame_exports--;
+}
+static void frameview_dealloc(frameviewObject *self) {
+	Py_XDECREF(self->strip);
+	PyObject_Del(self);
+}
+
+static PyBufferProcs frameview_as_buffer = {
+	(getbufferproc)frameview_getbuffer,
+	(releasebufferproc)frameview_releasebuffer,
+};
+
+static PyTypeObject frameview_Type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"apa102.FrameView",         /*tp_name*/
+	sizeof(frameviewObject),    /*tp_basicsize*/
+	0,                          /*tp_itemsize*/
+	/* methods */
+	(destructor)frameview_dealloc, /*tp_dealloc*/
+	0,                          /*tp_print*/
+	0,                          /*tp_getattr*/
+	0,                          /*tp_setattr*/
+	0,                          /*tp_reserved*/
+	0,                          /*tp_repr*/
+	0,                          /*tp_as_number*/
+	0,                          /*tp_as_sequence*/
+	0,                          /*tp_as_mapping*/
+	0,                          /*tp_hash*/
+	0,                          /*tp_call*/
+	0,                          /*tp_str*/
+	0,                          /*tp_getattro*/
+	0,                          /*tp_setattro*/
+	&frameview_as_buffer,       /*tp_as_buffer*/
+	Py_TPFLAGS_DEFAULT,         /*tp_flags*/
+};
+
+//returns a read only memoryview of len bytes at data, or NULL with an exception set
+PyObject * frame_memoryview(apa102Object *self, const byte *data, Py_ssize_t len) {
+	frameviewObject *owner = PyObject_New(frameviewObject, &frameview_Type);
+	if (owner == NULL)
+		return NULL;
+	Py_INCREF(self);
+	owner->strip = self;
+	owner->data = data;
+	owner->len = len;
+	PyObject *view = PyMemoryView_FromObject((PyObject*)owner);
+	Py_DECREF(owner);
+	return view;
+}
+
+//passes data to write_callback as a memoryview or list, from_frame is set when frame_list can be used
+//returns 0 on success or -1 with an exception set
+int call_write_callback(apa102Object *self, const byte *data, Py_ssize_t len, int from_frame) {
+	PyObject *view;
+	int kept = self->frame_exports;
+	if (self->legacy_list && from_frame && self->frame_list != NULL) {
+		//show_internal already brought frame_list up to date
+		view = self->frame_list;
+		Py_INCREF(view);
+	}
+	else if (self->legacy_list)
+		view = frame_as_list(data, len);
+	else
+		view = frame_memoryview(self, data, len);
+	if (view == NULL)
+		return -1;
+	
+	PyObject *result = PyObject_CallFunctionObjArgs(self->spi_write, view, NULL);
+	
+	if (!self->legacy_list) {
+		//the memoryview points straight at the frame, so the callback isn't meant to hang on to it
+		PyObject *type, *value, *traceback;
+		PyErr_Fetch(&type, &value, &traceback);
+		PyObject *released = PyObject_CallMethod(view, "release", NULL);
+		if (released == NULL)
+			PyErr_Clear();
+		Py_XDECREF(released);
+		PyErr_Restore(type, value, traceback);
+	}
+	Py_DECREF(view);
+	//anything still counted was kept by the callback. it stays valid because it holds on to the strip,
+	//but the frame under it keeps changing, so this is raised instead of going unnoticed
+	if (result != NULL && self->frame_exports > kept) {
+		Py_CLEAR(result);
+		PyErr_SetString(PyExc_BufferError, "write_callback must not keep the memoryview it is given, copy it with bytes() instead");
+	}
+	
+	if (result == NULL)
+		return -1;
+	Py_DECREF(result);
+	return 0;
+}
+
+//sends a whole frame to wherever this strip writes, needs the GIL
+//from_frame is set when segs is this object's own frame, so frame_list can be used in legacy_list mode
+//returns 0 on success or -1 with an exception set
+int transmit_internal(apa102Object *self, const segment *segs, int count, int from_frame) {
+	if (self->shm_mode == SHM_WRITE)
+		return shm_write_internal(self, segs, count);
+	if (self->fd >= 0) {
+		int err;
+		self->transmitting = 1;
+		Py_BEGIN_ALLOW_THREADS
+		err = write_fd_internal(self, segs, count);
+		Py_END_ALLOW_THREADS
+		self->transmitting = 0;
+		if (err) {
+			errno = err;
+			PyErr_SetFromErrno(PyExc_OSError);
+			return -1;
+		}
+		return 0;
+	}
+	
+	if (self->spi_write == NULL)
+		return 0;
+	
+	//write_callback needs the frame in one piece
+	const byte *data = segs[0].data;
+	Py_ssize_t len = segs[0].len;
+	int chunked = is_chunked(self);
+	if (count > 1 && !(self->legacy_list && from_frame && !chunked)) {
+		byte *wire = wire_buffer(self);
+		if (wire == NULL)
+			return -1;
+		gather_segments(wire, segs, count);
+		data = wire;
+		len = self->frame_len;
+	}
+	if (!chunked)
+		return call_write_callback(self, data, len, from_frame);
+	for (Py_ssize_t offset = 0; offset < len; offset += self->chunk_size) {
+		Py_ssize_t chunk = (len - offset < self->chunk_size) ? len - offset : self->chunk_size;
+		if (call_write_callback(self, data + offset, chunk, 0) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+//encoding: when the pixels have to be changed on the way out (gamma, dimmer) the frame is built in wire
+//only the dirty leds are encoded, the rest of wire still holds the last frame
+//threaded strips always send from wire, so the leds can be drawn on again while the copy goes out
+//a strip reading from shared memory encodes straight from there
+static inline int needs_encode(apa102Object *self) {
+	return self->lut_active || self->hdr || self->num_layers > 1 || self->threaded || self->shm_mode == SHM_READ;
+}
+//the leds that have to be encoded or updated before the next frame goes out
+void dirty_range(apa102Object *self, Py_ssize_t *start, Py_ssize_t *end) {
+	if (self->exports > 0) {
+		*start = 0;
+		*end = self->num_led;
+	}
+	else {
+		*start = self->dirty_start;
+		*end = self->dirty_end;
+	}
+}
+
+//puts the 5 bit brightness and the 8 bit color together: the brightest channel decides the 5 bit value,
+//and the colors are scaled up to match so dim colors keep more of their 16 bit gamma precision
+static inline void encode_hdr(apa102Object *self, byte *dst, const byte *src) {
+	uint32_t pixel_bright = *(src) & LED_BRIGHT_MASK;
+	uint32_t level[4], max = 0;
+	for (int j = 1; j < BYTES_PER_LED; j++) {
+		level[j] = self->lut16[*(src+j)] * pixel_bright / MAX_BRIGHTNESS;
+		if (level[j] > max)
+			max = level[j];
+	}
+	uint32_t bright = (max * MAX_BRIGHTNESS + 65534) / 65535;
+	*(dst) = LED_START | bright;
+	for (int j = 1; j < BYTES_PER_LED; j++) {
+		if (bright == 0)
+			*(dst+j) = 0;
+		else {
+			uint32_t scale = bright * 65535;
+			uint32_t value = (level[j] * MAX_BRIGHTNESS * 255 + scale/2) / scale;
+			*(dst+j) = (value > 255) ? 255 : value;
+		}
+	}
+}
+
+//encodes count leds from src into dst
+void encode_range(apa102Object *self, byte *dst, const byte *src, Py_ssize_t count) {
+	if (!self->lut_active && !self->hdr) {
+		memcpy(dst, src, count*BYTES_PER_LED);
+		return;
+	}
+	for (Py_ssize_t i = 0; i < count; i++) {
+		if (self->hdr)
+			encode_hdr(self, dst, src);
+		else {
+			*(dst) = *(src);
+			*(dst+1) = self->lut[*(src+1)];
+			*(dst+2) = self->lut[*(src+2)];
+			*(dst+3) = self->lut[*(src+3)];
+		}
+		dst += BYTES_PER_LED;
+		src += BYTES_PER_LED;
+	}
+}
+
+//encodes leds start to end (exclusive) into wire
+void encode_internal(apa102Object *self, byte *wire, Py_ssize_t start, Py_ssize_t end) {
+	byte *dst = wire + START_FRAME_BYTES + start*BYTES_PER_LED;
+	//at most two pieces, split where the ring wraps around
+	Py_ssize_t first = self->num_led - self->head - start;
+	if (first <= 0)
+		encode_range(self, dst, led_ptr(self, start), end - start);
+	else {
+		if (first > end - start)
+			first = end - start;
+		encode_range(self, dst, led_ptr(self, start), first);
+		if (first < end - start)
+			encode_range(self, dst + first*BYTES_PER_LED, self->leds, end - start - first);
+	}
+}
+
+//draws every layer together into composite for leds start to end (exclusive)
+//the selected layer's leds and head have to be put back in layers first
+void composite_internal(apa102Object *self, Py_ssize_t start, Py_ssize_t end) {
+	Py_ssize_t i = start;
+	while (i < end) {
+		//the longest piece where none of the layers wrap around their ring
+		Py_ssize_t count = end - i;
+		for (int l = 0; l < self->num_layers; l++) {
+			Py_ssize_t index = i + self->layers[l].head;
+			if (index >= self->num_led)
+				index -= self->num_led;
+			if (self->num_led - index < count)
+				count = self->num_led - index;
+		}
+		byte *dst = self->composite + i*BYTES_PER_LED;
+		for (int l = 0; l < self->num_layers; l++) {
+			const layer *lay = &self->layers[l];
+			Py_ssize_t index = i + lay->head;
+			if (index >= self->num_led)
+				index -= self->num_led;
+			if (l == 0)
+				memcpy(dst, lay->leds + index*BYTES_PER_LED, count*BYTES_PER_LED);
+			else if (lay->alpha_scale != 0)
+				blend_kernel(dst, lay->leds + index*BYTES_PER_LED, count, lay->mode, lay->alpha_scale);
+		}
+		i += count;
+	}
+}
+
+//looks up leds start to end (exclusive) in the palette and puts them in layer 0, as a render job
+static void palette_slice(apa102Object *self, const void *arg, Py_ssize_t start, Py_ssize_t end) {
+	byte *leds = (self->num_layers > 1) ? self->layers[0].leds : self->leds;
+	Py_ssize_t head = (self->num_layers > 1) ? self->layers[0].head : self->head;
+	//at most two pieces, split where the ring wraps around
+	while (start < end) {
+		Py_ssize_t index = start + head;
+		if (index >= self->num_led)
+			index -= self->num_led;
+		Py_ssize_t count = self->num_led - index;
+		if (count > end - start)
+			count = end - start;
+		byte *dst = leds + index*BYTES_PER_LED;
+		const byte *src = self->indices + start;
+		for (Py_ssize_t i = 0; i < count; i++)
+			memcpy(dst + i*BYTES_PER_LED, &self->palette[src[i]], BYTES_PER_LED);
+		start += count;
+	}
+}
+//puts the colors of the leds that changed into the frame, the selected layer's leds and head have to be put back in layers first
+void palette_expand_internal(apa102Object *self) {
+	Py_ssize_t start, end;
+	dirty_range(self, &start, &end);
+	render_range(self, palette_slice, NULL, start, end);
+}
+
+//render job for prepare_frame, arg is wire
+static void encode_slice(apa102Object *self, const void *arg, Py_ssize_t start, Py_ssize_t end) {
+	byte *wire = (byte*)arg;
+	if (self->num_layers > 1) {
+		composite_internal(self, start, end);
+		encode_range(self, wire + START_FRAME_BYTES + start*BYTES_PER_LED, self->composite + start*BYTES_PER_LED, end - start);
+	}
+	else
+		encode_internal(self, wire, start, end);
+}
+
+//gets the frame ready to send, encoding it if needed, and returns how many segments it takes or -1 with an exception set
+int prepare_frame(apa102Object *self, segment *segs) {
+	if (self->num_layers > 1) {
+		self->layers[self->current_layer].leds = self->leds;
+		self->layers[self->current_layer].head = self->head;
+	}
+	if (self->palette != NULL)
+		palette_expand_internal(self);
+	if (!needs_encode(self))
+		return frame_segments(self, segs);
+	byte *wire = wire_buffer(self);
+	if (wire == NULL)
+		return -1;
+	if (self->shm_mode == SHM_READ) {
+		if (shm_read_internal(self, wire) < 0)
+			return -1;
+		//frame_list only follows the strip's own leds, so it's made again from wire
+		Py_CLEAR(self->frame_list);
+		segs[0].data = wire;
+		segs[0].len = self->frame_len;
+		return 1;
+	}
+	Py_ssize_t start, end;
+	dirty_range(self, &start, &end);
+	render_range(self, encode_slice, wire, start, end);
+	segs[0].data = wire;
+	segs[0].len = self->frame_len;
+	return 1;
+}
+
+//only rewrites the items of frame_list for the leds that changed
+//if the callback held on to the last list or changed its length it can't be reused, so a new one is made
+int update_frame_list(apa102Object *self, const segment *segs, int count) {
+	if (self->frame_list != NULL && (Py_REFCNT(self->frame_list) > 1 || PyList_GET_SIZE(self->frame_list) != self->frame_len))
+		Py_CLEAR(self->frame_list);
+	if (self->frame_list == NULL) {
+		const byte *data = segs[0].data;
+		if (count > 1) {
+			byte *wire = wire_buffer(self);
+			if (wire == NULL)
+				return -1;
+			gather_segments(wire, segs, count);
+			data = wire;
+		}
+		self->frame_list = frame_as_list(data, self->frame_len);
+		return (self->frame_list == NULL) ? -1 : 0;
+	}
+	Py_ssize_t start, end;
+	dirty_range(self, &start, &end);
+	for (Py_ssize_t i = start; i < end; i++) {
+		//one segment means the frame is in one piece, otherwise it is the ring
+		const byte *start_ptr = (count == 1) ? segs[0].data + START_FRAME_BYTES + i*BYTES_PER_LED : led_ptr(self, i);
+		for (int j = 0; j < BYTES_PER_LED; j++) {
+			Py_ssize_t index = START_FRAME_BYTES + i*BYTES_PER_LED + j;
+			PyObject *old = PyList_GET_ITEM(self->frame_list, index);
+			PyList_SET_ITEM(self->frame_list, index, PyLong_FromLong((long)(*(start_ptr+j))));
+			Py_DECREF(old);
+		}
+	}
+	return 0;
+}
+
+//recorded animations:
+//a 16 byte header ("A102", a version byte, the 3 color offsets from rgb, num_led and fps*1000 as little endian uint32)
+//then for every show() a frame: a kind byte, the payload length as a little endian uint32, then the payload.
+//raw frames are the num_led*4 led bytes, delta frames are runs of (skipped leds, changed leds, changed led bytes)
+//with the counts as varints, relative to the frame before. the first frame is always raw.
+static const char ANIM_MAGIC[] = {'A', '1', '0', '2'};
+static const byte ANIM_VERSION = 1;
+#define ANIM_HEADER_BYTES 16
+#define ANIM_FRAME_HEADER_BYTES 5
+enum {ANIM_RAW, ANIM_DELTA};
+
+static inline void put_u32(byte *dst, uint32_t value) {
+	for (int i = 0; i < 4; i++)
+		*(dst+i) = (value >> (8*i)) & 255;
+}
+static inline uint32_t get_u32(const byte *src) {
+	return (uint32_t)*(src) | ((uint32_t)*(src+1) << 8) | ((uint32_t)*(src+2) << 16) | ((uint32_t)*(src+3) << 24);
+}
+static inline byte * put_varint(byte *dst, Py_ssize_t value) {
+	while (value >= 128) {
+		*(dst++) = (value & 127) | 128;
+		value >>= 7;
+	}
+	*(dst++) = (byte)value;
+	return dst;
+}
+//returns NULL if the varint runs past end
+//values are read as 64 bits, so a corrupt file can't wrap them around into something small or negative
+static inline const byte * get_varint(const byte *src, const byte *end, uint64_t *value) {
+	*value = 0;
+	for (int shift = 0; src < end && shift < 35; shift += 7) {
+		byte b = *(src++);
+		*value |= (uint64_t)(b & 127) << shift;
+		if (!(b & 128))
+			return src;
+	}
+	return NULL;
+}
+
+void record_stop_internal(apa102Object *self) {
+	if (self->rec_file != NULL)
+		fclose(self->rec_file);
+	self->rec_file = NULL;
+	PyMem_Free(self->rec_prev);
+	PyMem_Free(self->rec_buf);
+	self->rec_prev = NULL;
+	self->rec_buf = NULL;
+	self->rec_frames = 0;
+}
+
+//the led as it is shown, with every layer drawn in
+static inline const byte * shown_ptr(apa102Object *self, Py_ssize_t led_num) {
+	if (self->num_layers > 1)
+		return self->composite + led_num*BYTES_PER_LED;
+	return led_ptr(self, led_num);
+}
+
+//appends the shown leds to the recording as a delta frame, or a raw one if that is smaller, returns -1 with an exception set
+//has to be called after prepare_frame() so the layers are drawn together
+int record_frame_internal(apa102Object *self) {
+	if (self->rec_file == NULL)
+		return 0;
+	Py_ssize_t raw_len = self->num_led_array;
+	byte *payload = self->rec_buf + ANIM_FRAME_HEADER_BYTES;
+	byte *dst = payload;
+	byte kind = ANIM_DELTA;
+	if (self->rec_frames > 0) {
+		//only leds in the dirty range can have changed since the last frame was recorded
+		Py_ssize_t start, end, last = 0;
+		dirty_range(self, &start, &end);
+		Py_ssize_t i = start;
+		while (i < end && kind == ANIM_DELTA) {
+			if (memcmp(shown_ptr(self, i), self->rec_prev + i*BYTES_PER_LED, BYTES_PER_LED) == 0) {
+				i++;
+				continue;
+			}
+			Py_ssize_t run_end = i + 1;
+			while (run_end < end && memcmp(shown_ptr(self, run_end), self->rec_prev + run_end*BYTES_PER_LED, BYTES_PER_LED) != 0)
+				run_end++;
+			//10 bytes covers both varints
+			if ((dst - payload) + 10 + (run_end - i)*BYTES_PER_LED >= raw_len) {
+				kind = ANIM_RAW;
+				break;
+			}
+			dst = put_varint(dst, i - last);
+			dst = put_varint(dst, run_end - i);
+			for (; i < run_end; i++) {
+				memcpy(dst, shown_ptr(self, i), BYTES_PER_LED);
+				memcpy(self->rec_prev + i*BYTES_PER_LED, dst, BYTES_PER_LED);
+				dst += BYTES_PER_LED;
+			}
+			last = run_end;
+		}
+	}
+	else
+		kind = ANIM_RAW;
+	if (kind == ANIM_RAW && self->num_layers > 1)
+		memcpy(payload, self->composite, raw_len);
+	else if (kind == ANIM_RAW) {
+		//the ring is stored in two pieces, led 0 at head
+		Py_ssize_t split = (self->num_led - self->head) * BYTES_PER_LED;
+		memcpy(payload, self->leds + self->head*BYTES_PER_LED, split);
+		memcpy(payload + split, self->leds, raw_len - split);
+	}
+	if (kind == ANIM_RAW) {
+		memcpy(self->rec_prev, payload, raw_len);
+		dst = payload + raw_len;
+	}
+	*(self->rec_buf) = kind;
+	put_u32(self->rec_buf + 1, (uint32_t)(dst - payload));
+	if (fwrite(self->rec_buf, 1, dst - self->rec_buf, self->rec_file) != (size_t)(dst - self->rec_buf)) {
+		PyErr_SetFromErrno(PyExc_OSError);
+		record_stop_internal(self);
+		return -1;
+	}
+	self->rec_frames++;
+	return 0;
+}
+
+//everything show() does, also used by present()
+//returns 1 if the frame was sent, 0 if nothing changed since the last one, or -1 with an exception set
+int show_internal(apa102Object *self, int force) {
+	//when threaded, every segment is locked until the frame has been copied into wire
+	int result = -1, locked = 1;
+	//frames queued by show_async() go out first, so two writes never share the device and frames stay in order
+	async_wait_internal(self, NULL);
+	lock_show(self);
+	lock_range(self, 0, self->num_led);
+	if (!force && !frame_pending(self)) {
+		result = record_frame_internal(self);
+		goto done;
+	}
+	uint64_t start = self->stats_enabled ? monotonic_ns() : 0;
+	segment segs[MAX_SEGMENTS];
+	int count = prepare_frame(self, segs);
+	if (count < 0)
+		goto done;
+	if (record_frame_internal(self) < 0)
+		goto done;
+	if (self->legacy_list && self->spi_write != NULL && !is_chunked(self) && update_frame_list(self, segs, count) < 0)
+		goto done;
+	//the dirty span is cleared before the GIL is let go for the write, so anything drawn while it runs
+	//stays dirty and goes out with the next frame
+	mark_clean(self);
+	if (self->threaded) {
+		unlock_range(self, 0, self->num_led);
+		locked = 0;
+	}
+	uint64_t encoded = self->stats_enabled ? monotonic_ns() : 0;
+	if (transmit_internal(self, segs, count, 1) < 0)
+		goto failed;
+	if (self->stats_enabled) {
+		uint64_t sent = monotonic_ns();
+		self->stat_frames++;
+		self->stat_bytes += self->frame_len;
+		self->stat_encode_ns += encoded - start;
+		self->stat_write_ns += sent - encoded;
+		self->stat_latency_total += sent - start;
+		if (sent - start > self->stat_latency_max)
+			self->stat_latency_max = sent - start;
+	}
+	result = 1;
+	goto done;
+failed:
+	//the frame didn't go out, so all of it is sent next time
+	mark_dirty(self, 0, self->num_led);
+done:
+	if (locked)
+		unlock_range(self, 0, self->num_led);
+	unlock_show(self);
+	return result;
+}
+
+PyDoc_STRVAR(apa102_show_doc,
+	"show([force=False])\n\n"
+	"sends the data to the pixels to display\n"
+	"if nothing changed since the last time, nothing is sent unless force is True\n"
+	"returns True if the frame was sent");
+static PyObject * apa102_show(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"force", NULL};
+	static const char *types = "|p:show";
+	int force = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &force))
+		return NULL;
+	int sent = show_internal(self, force);
+	if (sent < 0)
+		return NULL;
+	return PyBool_FromLong(sent);
+}
+
+//asynchronous show:
+//show_async() copies the frame into a free buffer and queues it, the worker thread sends the queue in order.
+//there are async_depth+1 buffers: up to async_depth queued frames plus the one being sent.
+enum {ASYNC_BLOCK, ASYNC_DROP, ASYNC_COALESCE};
+static const char *ASYNC_POLICIES[] = {"block", "drop", "coalesce", NULL};
+
+static void * async_worker(void *arg) {
+	apa102Object *self = (apa102Object*)arg;
+	pthread_mutex_lock(&self->async_lock);
+	for (;;) {
+		while (!self->async_stop && self->async_count == 0)
+			pthread_cond_wait(&self->async_cond, &self->async_lock);
+		if (self->async_stop)
+			break;
+		
+		byte *data = self->async_queue[self->async_head];
+		self->async_head = (self->async_head + 1) % self->async_depth;
+		self->async_count--;
+		self->async_sending = data;
+		uint64_t start = self->stats_enabled ? monotonic_ns() : 0;
+		pthread_cond_broadcast(&self->async_cond);
+		pthread_mutex_unlock(&self->async_lock);
+		
+		int err = 0;
+		segment seg = {data, self->frame_len};
+		if (self->fd >= 0 && self->shm_mode != SHM_WRITE)
+			err = write_fd_internal(self, &seg, 1);
+		else {
+			PyGILState_STATE gstate = PyGILState_Ensure();
+			if (transmit_internal(self, &seg, 1, 0) < 0 && self->async_error == NULL) {
+				//keep the first error to raise from the next show_async() or wait()
+				PyObject *type, *traceback;
+				PyErr_Fetch(&type, &self->async_error, &traceback);
+				PyErr_NormalizeException(&type, &self->async_error, &traceback);
+				if (traceback != NULL)
+					PyException_SetTraceback(self->async_error, traceback);
+				Py_XDECREF(type);
+				Py_XDECREF(traceback);
+			}
+			PyErr_Clear();
+			PyGILState_Release(gstate);
+		}
+		
+		pthread_mutex_lock(&self->async_lock);
+		if (err && self->async_errno == 0)
+			self->async_errno = err;
+		if (start != 0 && !err) {
+			self->stat_async_frames++;
+			self->stat_async_bytes += self->frame_len;
+			self->stat_async_write_ns += monotonic_ns() - start;
+		}
+		self->async_free[self->async_free_count++] = data;
+		self->async_sending = NULL;
+		pthread_cond_broadcast(&self->async_cond);
+	}
+	pthread_mutex_unlock(&self->async_lock);
+	return NULL;
+}
+
+//stops the worker thread, dropping anything still queued, and frees the buffers
+//needs the GIL, which is let go while waiting for the frame being sent to finish
+void async_stop_internal(apa102Object *self) {
+	if (!self->async_running)
+		return;
+	pthread_mutex_lock(&self->async_lock);
+	self->async_stop = 1;
+	pthread_cond_broadcast(&self->async_cond);
+	pthread_mutex_unlock(&self->async_lock);
+	Py_BEGIN_ALLOW_THREADS
+	pthread_join(self->async_thread, NULL);
+	Py_END_ALLOW_THREADS
+	self->async_running = 0;
+	self->async_stop = 0;
+	self->async_count = 0;
+	self->async_head = 0;
+	self->async_free_count = 0;
+	PyMem_Free(self->async_buffers);
+	PyMem_Free(self->async_queue);
+	self->async_buffers = NULL;
+	self->async_queue = NULL;
+	self->async_free = NULL;
+}
+
+int async_start_internal(apa102Object *self) {
+	int buffers = self->async_depth + 1;
+	self->async_buffers = PyMem_Calloc(buffers, self->frame_len);
+	//async_queue holds async_depth pointers followed by the free list of async_depth+1 pointers
+	self->async_queue = PyMem_Calloc(self->async_depth + buffers, sizeof(byte*));
+	if (self->async_buffers == NULL || self->async_queue == NULL) {
+		PyMem_Free(self->async_buffers);
+		PyMem_Free(self->async_queue);
+		self->async_buffers = NULL;
+		self->async_queue = NULL;
+		PyErr_NoMemory();
+		return -1;
+	}
+	self->async_free = self->async_queue + self->async_depth;
+	for (int i = 0; i < buffers; i++)
+		self->async_free[i] = self->async_buffers + i*self->frame_len;
+	self->async_free_count = buffers;
+	self->async_head = 0;
+	self->async_count = 0;
+	self->async_stop = 0;
+	
+	//make sure python is ready for other threads before the worker calls PyGILState_Ensure
+#if PY_VERSION_HEX < 0x03070000
+	PyEval_InitThreads();
+#endif
+	int err = pthread_create(&self->async_thread, NULL, async_worker, self);
+	if (err) {
+		PyMem_Free(self->async_buffers);
+		PyMem_Free(self->async_queue);
+		self->async_buffers = NULL;
+		self->async_queue = NULL;
+		errno = err;
+		PyErr_SetFromErrno(PyExc_OSError);
+		return -1;
+	}
+	self->async_running = 1;
+	return 0;
+}
+
+//raises (and clears) an error the worker ran into, returns -1 if there was one
+int async_check_error(apa102Object *self) {
+	if (self->async_error != NULL) {
+		PyErr_SetObject((PyObject*)Py_TYPE(self->async_error), self->async_error);
+		Py_CLEAR(self->async_error);
+		return -1;
+	}
+	pthread_mutex_lock(&self->async_lock);
+	int err = self->async_errno;
+	self->async_errno = 0;
+	pthread_mutex_unlock(&self->async_lock);
+	if (err) {
+		errno = err;
+		PyErr_SetFromErrno(PyExc_OSError);
+		return -1;
+	}
+	return 0;
+}
+
+PyDoc_STRVAR(apa102_show_async_doc,
+	"show_async([force=False])\n\n"
+	"copies the current frame and returns right away, a background thread sends it to the pixels\n"
+	"like show(), nothing is queued if nothing changed unless force is True\n"
+	"what happens when the queue is full is set by set_async_policy, call wait() to know when it has been sent\n"
+	"errors from sending are raised by the next call to show_async or wait");
+static PyObject * apa102_show_async(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"force", NULL};
+	static const char *types = "|p:show_async";
+	int force = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &force))
+		return NULL;
+	if (async_check_error(self) < 0)
+		return NULL;
+	//locked the same way as show()
+	PyObject *result = NULL;
+	int locked = 1;
+	lock_show(self);
+	lock_range(self, 0, self->num_led);
+	if (!force && !frame_pending(self)) {
+		if (record_frame_internal(self) == 0)
+			result = Py_False;
+		goto done;
+	}
+	if (self->fd < 0 && self->spi_write == NULL && self->shm_mode != SHM_WRITE) {
+		result = Py_False;
+		goto done;
+	}
+	if (!self->async_running && async_start_internal(self) < 0)
+		goto done;
+	uint64_t start = self->stats_enabled ? monotonic_ns() : 0;
+	segment segs[MAX_SEGMENTS];
+	int count = prepare_frame(self, segs);
+	if (count < 0)
+		goto done;
+	if (record_frame_internal(self) < 0)
+		goto done;
+	if (self->stats_enabled)
+		self->stat_encode_ns += monotonic_ns() - start;
+	if (self->threaded) {
+		mark_clean(self);
+		unlock_range(self, 0, self->num_led);
+		locked = 0;
+	}
+	
+	pthread_mutex_lock(&self->async_lock);
+	while (self->async_policy == ASYNC_BLOCK && self->async_count >= self->async_depth) {
+		//let go of the GIL while waiting, the worker might need it to call write_callback
+		pthread_mutex_unlock(&self->async_lock);
+		Py_BEGIN_ALLOW_THREADS
+		pthread_mutex_lock(&self->async_lock);
+		while (self->async_count >= self->async_depth)
+			pthread_cond_wait(&self->async_cond, &self->async_lock);
+		pthread_mutex_unlock(&self->async_lock);
+		Py_END_ALLOW_THREADS
+		pthread_mutex_lock(&self->async_lock);
+	}
+	byte *data;
+	if (self->async_count < self->async_depth) {
+		data = self->async_free[--self->async_free_count];
+		self->async_queue[(self->async_head + self->async_count) % self->async_depth] = data;
+		self->async_count++;
+	}
+	else if (self->async_policy == ASYNC_DROP) {
+		//the oldest queued frame is thrown away, since the queue is full its slot becomes the back of the queue
+		data = self->async_queue[self->async_head];
+		self->async_head = (self->async_head + 1) % self->async_depth;
+	}
+	else {
+		//the newest queued frame is replaced by this one
+		data = self->async_queue[(self->async_head + self->async_count - 1) % self->async_depth];
+	}
+	gather_segments(data, segs, count);
+	pthread_cond_broadcast(&self->async_cond);
+	pthread_mutex_unlock(&self->async_lock);
+	if (!self->threaded)
+		mark_clean(self);
+	//frame_list only knows about changes since the last show(), so it has to be rebuilt
+	Py_CLEAR(self->frame_list);
+	result = Py_True;
+done:
+	if (locked)
+		unlock_range(self, 0, self->num_led);
+	unlock_show(self);
+	Py_XINCREF(result);
+	return result;
+}
+
+//waits for the queue to empty out, deadline is a CLOCK_REALTIME time or NULL to wait forever
+//needs the GIL, which is let go while waiting. returns 1 if everything was sent
+int async_wait_internal(apa102Object *self, const struct timespec *deadline) {
+	int done = 1;
+	if (!self->async_running)
+		return done;
+	Py_BEGIN_ALLOW_THREADS
+	pthread_mutex_lock(&self->async_lock);
+	while (self->async_count > 0 || self->async_sending != NULL) {
+		if (deadline == NULL)
+			pthread_cond_wait(&self->async_cond, &self->async_lock);
+		else if (pthread_cond_timedwait(&self->async_cond, &self->async_lock, deadline) == ETIMEDOUT) {
+			done = (self->async_count == 0 && self->async_sending == NULL);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&self->async_lock);
+	Py_END_ALLOW_THREADS
+	return done;
+}
+
+PyDoc_STRVAR(apa102_wait_doc,
+	"wait([timeout=None])\n\n"
+	"waits until every frame given to show_async has been sent\n"
+	"returns False if timeout (in seconds) ran out first, otherwise True");
+static PyObject * apa102_wait(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"timeout", NULL};
+	static const char *types = "|O:wait";
+	PyObject *timeout_obj = Py_None;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &timeout_obj))
+		return NULL;
+	
+	struct timespec deadline;
+	if (timeout_obj != Py_None) {
+		double timeout = PyFloat_AsDouble(timeout_obj);
+		if (timeout == -1.0 && PyErr_Occurred())
+			return NULL;
+		if (timeout < 0)
+			timeout = 0;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += (time_t)timeout;
+		deadline.tv_nsec += (long)((timeout - (time_t)timeout) * 1e9);
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+	}
+	
+	int done = async_wait_internal(self, (timeout_obj != Py_None) ? &deadline : NULL);
+	if (async_check_error(self) < 0)
+		return NULL;
+	return PyBool_FromLong(done);
+}
+
+PyDoc_STRVAR(apa102_set_async_policy_doc,
+	"set_async_policy([policy=\"block\"], [depth=1])\n\n"
+	"sets how many frames show_async can queue up and what it does when the queue is full:\n"
+	"\t\"block\" -- wait for room in the queue\n"
+	"\t\"drop\" -- throw away the oldest queued frame\n"
+	"\t\"coalesce\" -- replace the newest queued frame\n"
+	"waits for frames already queued to be sent first");
+static PyObject * apa102_set_async_policy(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"policy", "depth", NULL};
+	static const char *types = "|si:set_async_policy";
+	const char *policy_name = ASYNC_POLICIES[ASYNC_BLOCK];
+	int depth = 1;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &policy_name, &depth))
+		return NULL;
+	
+	int policy = -1;
+	for (int i = 0; ASYNC_POLICIES[i] != NULL; i++) {
+		if (strcmp(policy_name, ASYNC_POLICIES[i]) == 0)
+			policy = i;
+	}
+	if (policy < 0) {
+		PyErr_SetString(PyExc_ValueError, "policy must be \"block\", \"drop\", or \"coalesce\"");
+		return NULL;
+	}
+	if (depth < 1) {
+		PyErr_SetString(PyExc_ValueError, "depth must be at least 1");
+		return NULL;
+	}
+	
+	//write_callback could have kept a view of one of the buffers that are about to be freed
+	if (self->frame_exports > 0) {
+		PyErr_SetString(PyExc_BufferError, "cannot change the queue while write_callback holds on to a frame");
+		return NULL;
+	}
+	//the buffers are sized for the old depth, so finish what is queued and start over
+	async_wait_internal(self, NULL);
+	async_stop_internal(self);
+	if (async_check_error(self) < 0)
+		return NULL;
+	self->async_policy = policy;
+	self->async_depth = depth;
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(apa102_set_render_threads_doc,
+	"set_render_threads([threads=0], [min_leds=20000])\n\n"
+	"splits the work on big strips between threads: set_range, set_all, clear_strip, fill_rainbow, fill_gradient,\n"
+	"fade_to_black, and getting the frame ready in show (gamma, dimming, and drawing the layers together)\n"
+	"\tthreads -- how many threads to use, including the one calling, 0 for one per cpu and 1 to stop splitting work up\n"
+	"\tmin_leds -- anything touching fewer leds than this is done by the calling thread alone");
+static PyObject * apa102_set_render_threads(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"threads", "min_leds", NULL};
+	static const char *types = "|in:set_render_threads";
+	int threads = 0;
+	Py_ssize_t min_leds = RENDER_MIN_LEDS;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &threads, &min_leds))
+		return NULL;
+	if (threads < 0) {
+		PyErr_SetString(PyExc_ValueError, "threads must not be negative");
+		return NULL;
+	}
+	if (min_leds < 0) {
+		PyErr_SetString(PyExc_ValueError, "min_leds must not be negative");
+		return NULL;
+	}
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (cpus > 0) ? cpus : 1;
+	}
+	
+	render_stop_internal(self);
+	self->render_min_leds = min_leds;
+	if (threads > 1 && render_start_internal(self, threads) < 0)
+		return NULL;
+	Py_RETURN_NONE;
+}
+
+//frame pacing:
+
+//sleeps until deadline (a CLOCK_MONOTONIC time in ns) without the GIL, returns -1 if a signal handler raised
+int sleep_until_internal(uint64_t deadline) {
+	struct timespec ts;
+	ts.tv_sec = deadline / 1000000000ull;
+	ts.tv_nsec = deadline % 1000000000ull;
+	for (;;) {
+		int err;
+		Py_BEGIN_ALLOW_THREADS
+		err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		Py_END_ALLOW_THREADS
+		if (err != EINTR)
+			return 0;
+		if (PyErr_CheckSignals() < 0)
+			return -1;
+	}
+}
+
+void record_interval_internal(apa102Object *self, uint64_t now) {
+	if (self->pace_last_present != 0) {
+		self->pace_intervals[self->pace_interval_pos] = now - self->pace_last_present;
+		self->pace_interval_pos = (self->pace_interval_pos + 1) % PACE_INTERVALS;
+		if (self->pace_interval_count < PACE_INTERVALS)
+			self->pace_interval_count++;
+	}
+	self->pace_last_present = now;
+	self->pace_frames++;
+}
+
+//rebuilds lut and lut16 from the gamma table and the dimmer
+void update_lut(apa102Object *self) {
+	int identity = 1;
+	for (int i = 0; i < 256; i++) {
+		self->lut[i] = (self->gamma_table[i] * self->dimmer + 127) / 255;
+		self->lut16[i] = (self->gamma_table16[i] * self->dimmer + 127) / 255;
+		identity = identity && (self->lut[i] == i);
+	}
+	self->lut_active = !identity;
+	//every led looks different now
+	mark_dirty(self, 0, self->num_led);
+}
+
+PyDoc_STRVAR(apa102_set_gamma_doc,
+	"set_gamma([gamma=1.0], [table=None], [hdr=False])\n\n"
+	"sets the gamma correction done when the frame is sent, the colors stored (and returned by get_pixel_color) stay as they were set\n"
+	"\tgamma -- each color is sent as 255 * (color / 255) ** gamma, 1.0 turns it off\n"
+	"\ttable -- instead of gamma, a buffer of 256 bytes giving the value to send for each color\n"
+	"\thdr -- if True, the 5 bit brightness of each pixel is picked to get the most out of the 8 bit colors,\n"
+	"\t\tgiving dim colors more precision (the pixel's own brightness still scales it)");
+static PyObject * apa102_set_gamma(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"gamma", "table", "hdr", NULL};
+	static const char *types = "|dOp:set_gamma";
+	double gamma = 1.0;
+	PyObject *table = Py_None;
+	int hdr = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &gamma, &table, &hdr))
+		return NULL;
+	if (gamma <= 0) {
+		PyErr_SetString(PyExc_ValueError, "gamma must be greater than 0");
+		return NULL;
+	}
+	
+	if (table != Py_None) {
+		Py_buffer buffer;
+		if (PyObject_GetBuffer(table, &buffer, PyBUF_SIMPLE) < 0)
+			return NULL;
+		if (buffer.len != 256) {
+			PyBuffer_Release(&buffer);
+			PyErr_SetString(PyExc_ValueError, "table must be 256 bytes long");
+			return NULL;
+		}
+		for (int i = 0; i < 256; i++) {
+			self->gamma_table[i] = *((byte*)buffer.buf + i);
+			self->gamma_table16[i] = self->gamma_table[i] * 257;
+		}
+		PyBuffer_Release(&buffer);
+		self->gamma = 0;
+	}
+	else {
+		for (int i = 0; i < 256; i++) {
+			double level = pow(i / 255.0, gamma);
+			self->gamma_table[i] = (byte)(level * 255 + 0.5);
+			self->gamma_table16[i] = (uint16_t)(level * 65535 + 0.5);
+		}
+		self->gamma = gamma;
+	}
+	lock_range(self, 0, self->num_led);
+	self->hdr = hdr;
+	update_lut(self);
+	unlock_range(self, 0, self->num_led);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(apa102_set_dimmer_doc,
+	"set_dimmer(level)\n\n"
+	"dims the whole strip when the frame is sent, from 0 (off) to 255 (not dimmed)\n"
+	"this only changes a 256 entry table, so fading the strip costs the same no matter how many pixels it has");
+static PyObject * apa102_set_dimmer(apa102Object *self, PyObject *args)
+{
+	static const char *types = "b:set_dimmer";
+	unsigned char level;
+	if (!PyArg_ParseTuple(args, types, &level))
+		return NULL;
+	if (level != self->dimmer) {
+		lock_range(self, 0, self->num_led);
+		self->dimmer = level;
+		update_lut(self);
+		unlock_range(self, 0, self->num_led);
+	}
+	Py_RETURN_NONE;
+}
+
+//moves leds and head over to another layer, the selected one's are kept in layers until it is selected again
+void select_layer_internal(apa102Object *self, int index) {
+	if (self->num_layers == 0 || index == self->current_layer)
+		return;
+	self->layers[self->current_layer].leds = self->leds;
+	self->layers[self->current_layer].head = self->head;
+	self->leds = self->layers[index].leds;
+	self->head = self->layers[index].head;
+	self->current_layer = index;
+}
+
+void layers_free_internal(apa102Object *self) {
+	select_layer_internal(self, 0);
+	for (int l = 1; l < self->num_layers; l++)
+		PyMem_Free(self->layers[l].leds);
+	PyMem_Free(self->layers);
+	PyMem_Free(self->composite);
+	self->layers = NULL;
+	self->composite = NULL;
+	self->num_layers = 0;
+	self->current_layer = 0;
+}
+
+//reads an opacity and mode for a layer, mode may be NULL to leave it as is
+int set_layer_internal(layer *lay, double opacity, const char *mode_name) {
+	if (opacity < 0 || opacity > 1) {
+		PyErr_SetString(PyExc_ValueError, "opacity must be from 0 to 1");
+		return -1;
+	}
+	if (mode_name != NULL) {
+		int mode = -1;
+		for (int i = 0; BLEND_MODES[i] != NULL; i++) {
+			if (strcmp(mode_name, BLEND_MODES[i]) == 0)
+				mode = i;
+		}
+		if (mode < 0) {
+			PyErr_SetString(PyExc_ValueError, "mode must be \"normal\", \"add\", \"multiply\", \"screen\", or \"max\"");
+			return -1;
+		}
+		lay->mode = mode;
+	}
+	lay->opacity = opacity;
+	lay->alpha_scale = (uint16_t)(opacity * 255 * 256 / MAX_BRIGHTNESS + 0.5);
+	return 0;
+}
+
+//adds lay to the end of layers, setting them up first if needed. returns its index or -1 if out of memory
+int add_layer_internal(apa102Object *self, layer *lay) {
+	if (self->num_layers == 0) {
+		self->composite = PyMem_Malloc(self->num_led_array + 1);
+		self->layers = PyMem_Malloc(sizeof(layer));
+		if (self->composite == NULL || self->layers == NULL) {
+			layers_free_internal(self);
+			return -1;
+		}
+		self->layers[0].leds = self->leds;
+		self->layers[0].head = self->head;
+		set_layer_internal(&self->layers[0], 1.0, BLEND_MODES[BLEND_NORMAL]);
+		self->num_layers = 1;
+		self->current_layer = 0;
+	}
+	layer *layers = PyMem_Realloc(self->layers, (self->num_layers + 1)*sizeof(layer));
+	if (layers == NULL)
+		return -1;
+	self->layers = layers;
+	lay->leds = PyMem_Malloc(self->num_led_array + 1);
+	if (lay->leds == NULL)
+		return -1;
+	for (Py_ssize_t i = 0; i < self->num_led_array; i += BYTES_PER_LED) {
+		*(lay->leds+i) = LED_START;
+		memset(lay->leds+i+1, 0, BYTES_PER_LED-1);
+	}
+	lay->head = 0;
+	self->layers[self->num_layers] = *lay;
+	self->num_layers++;
+	mark_dirty(self, 0, self->num_led);
+	return self->num_layers - 1;
+}
+
+PyDoc_STRVAR(apa102_add_layer_doc,
+	"add_layer([opacity=1.0], [mode=\"normal\"])\n\n"
+	"adds a layer of pixels that is drawn over the ones below it when the frame is sent, use select_layer to draw on it\n"
+	"the brightness of each pixel on a layer is how much it covers the pixels below, so a new layer (or a cleared one) is see through\n"
+	"\topacity -- how much the whole layer covers the layers below it, from 0 to 1\n"
+	"\tmode -- how the colors are combined: \"normal\", \"add\", \"multiply\", \"screen\", or \"max\"\n"
+	"returns the number of the new layer");
+static PyObject * apa102_add_layer(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"opacity", "mode", NULL};
+	static const char *types = "|ds:add_layer";
+	double opacity = 1.0;
+	const char *mode_name = BLEND_MODES[BLEND_NORMAL];
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &opacity, &mode_name))
+		return NULL;
+	layer lay;
+	if (set_layer_internal(&lay, opacity, mode_name) < 0)
+		return NULL;
+	if (self->leds == NULL) {
+		PyErr_SetString(PyExc_RuntimeError, "APA102 object is not initialized");
+		return NULL;
+	}
+	
+	//layers and composite move, so nothing can be drawn or shown meanwhile
+	lock_range(self, 0, self->num_led);
+	int index = add_layer_internal(self, &lay);
+	unlock_range(self, 0, self->num_led);
+	if (index < 0)
+		return PyErr_NoMemory();
+	return PyLong_FromLong(index);
+}
+
+PyDoc_STRVAR(apa102_select_layer_doc,
+	"select_layer(index)\n\n"
+	"makes every function that sets or gets pixels (and the buffer of this object) work on the layer at index, 0 is the bottom one");
+static PyObject * apa102_select_layer(apa102Object *self, PyObject *args)
+{
+	int index;
+	if (!PyArg_ParseTuple(args, "i:select_layer", &index))
+		return NULL;
+	int num_layers = (self->num_layers > 0) ? self->num_layers : 1;
+	if (index < 0 || index >= num_layers) {
+		PyErr_SetString(PyExc_IndexError, "layer index out of range");
+		return NULL;
+	}
+	if (self->exports > 0 && index != self->current_layer) {
+		PyErr_SetString(PyExc_BufferError, "cannot select another layer while the pixels are exported");
+		return NULL;
+	}
+	lock_range(self, 0, self->num_led);
+	select_layer_internal(self, index);
+	unlock_range(self, 0, self->num_led);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(apa102_set_layer_doc,
+	"set_layer(index, opacity, [mode])\n\n"
+	"changes the opacity (from 0 to 1) and optionally the mode of a layer added by add_layer");
+static PyObject * apa102_set_layer(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"index", "opacity", "mode", NULL};
+	static const char *types = "id|z:set_layer";
+	int index;
+	double opacity;
+	const char *mode_name = NULL;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &index, &opacity, &mode_name))
+		return NULL;
+	if (index < 1 || index >= self->num_layers) {
+		PyErr_SetString(PyExc_IndexError, "layer index out of range, layer 0 is always drawn as is");
+		return NULL;
+	}
+	//marked dirty before the locks are let go, or a show() in between could send the old blend and mark it clean
+	lock_range(self, 0, self->num_led);
+	int err = set_layer_internal(&self->layers[index], opacity, mode_name);
+	if (err == 0)
+		mark_dirty(self, 0, self->num_led);
+	unlock_range(self, 0, self->num_led);
+	if (err < 0)
+		return NULL;
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(apa102_remove_layers_doc,
+	"remove_layers()\n\n"
+	"removes every layer added by add_layer and selects layer 0");
+static PyObject * apa102_remove_layers(apa102Object *self, PyObject *args)
+{
+	if (self->exports > 0 && self->current_layer != 0) {
+		PyErr_SetString(PyExc_BufferError, "cannot remove layers while one is exported");
+		return NULL;
+	}
+	lock_range(self, 0, self->num_led);
+	if (self->num_layers > 1)
+		mark_dirty(self, 0, self->num_led);
+	layers_free_internal(self);
+	unlock_range(self, 0, self->num_led);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(apa102_set_target_fps_doc,
+	"set_target_fps(fps, [skip_late=False])\n\n"
+	"sets how many frames per second present() shows, 0 makes present() show right away\n"
+	"a frame is late when present() is called more than half a frame after its deadline,\n"
+	"if skip_late is True late frames are not sent at all");
+static PyObject * apa102_set_target_fps(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"fps", "skip_late", NULL};
+	static const char *types = "d|p:set_target_fps";
+	double fps;
+	int skip_late = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &fps, &skip_late))
+		return NULL;
+	if (fps < 0) {
+		PyErr_SetString(PyExc_ValueError, "fps must not be negative");
+		return NULL;
+	}
+	self->pace_period = (fps > 0) ? (uint64_t)(1e9 / fps) : 0;
+	self->pace_skip_late = skip_late;
+	self->pace_deadline = 0;
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(apa102_present_doc,
+	"present()\n\n"
+	"waits for the next frame deadline set by set_target_fps, then calls show() (which skips unchanged frames)\n"
+	"returns False if the frame was late and skipped, otherwise True");
+static PyObject * apa102_present(apa102Object *self, PyObject *args)
+{
+	uint64_t now = monotonic_ns();
+	if (self->pace_period != 0) {
+		if (self->pace_deadline == 0)
+			self->pace_deadline = now;
+		
+		if (now > self->pace_deadline + self->pace_period/2) {
+			self->pace_late++;
+			//move on to the next deadline that hasn't passed yet instead of rushing to catch up
+			uint64_t missed = (now - self->pace_deadline) / self->pace_period;
+			self->pace_deadline += missed * self->pace_period;
+			if (self->pace_skip_late) {
+				self->pace_dropped++;
+				self->pace_deadline += self->pace_period;
+				Py_RETURN_FALSE;
+			}
+		}
+		else if (now < self->pace_deadline) {
+			if (sleep_until_internal(self->pace_deadline) < 0)
+				return NULL;
+			now = monotonic_ns();
+		}
+		self->pace_deadline += self->pace_period;
+	}
+	
+	if (show_internal(self, 0) < 0)
+		return NULL;
+	record_interval_internal(self, now);
+	Py_RETURN_TRUE;
+}
+
+PyDoc_STRVAR(apa102_record_doc,
+	"record(path, [fps])\n\n"
+	"starts recording every frame given to show(), show_async(), or present() to the file at path, which play() can show later\n"
+	"frames are stored as the changes from the frame before, so long recordings stay small\n"
+	"optional- the fps to play the recording back at, the default is the one from set_target_fps or 30");
+static PyObject * apa102_record(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"path", "fps", NULL};
+	static const char *types = "O&|d:record";
+	PyObject *path = NULL;
+	double fps = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, PyUnicode_FSConverter, &path, &fps))
+		return NULL;
+	if (fps <= 0)
+		fps = (self->pace_period != 0) ? 1e9 / self->pace_period : 30;
+	if (fps * 1000 > UINT32_MAX) {
+		Py_DECREF(path);
+		PyErr_SetString(PyExc_ValueError, "fps is too high");
+		return NULL;
+	}
+	record_stop_internal(self);
+	
+	self->rec_prev = PyMem_Malloc(self->num_led_array + 1);
+	self->rec_buf = PyMem_Malloc(ANIM_FRAME_HEADER_BYTES + self->num_led_array);
+	if (self->rec_prev == NULL || self->rec_buf == NULL) {
+		Py_DECREF(path);
+		record_stop_internal(self);
+		return PyErr_NoMemory();
+	}
+	self->rec_file = fopen(PyBytes_AS_STRING(path), "wbe");
+	if (self->rec_file == NULL) {
+		PyErr_SetFromErrnoWithFilename(PyExc_OSError, PyBytes_AS_STRING(path));
+		Py_DECREF(path);
+		record_stop_internal(self);
+		return NULL;
+	}
+	Py_DECREF(path);
+	self->rec_frames = 0;
+	
+	byte header[ANIM_HEADER_BYTES];
+	memcpy(header, ANIM_MAGIC, sizeof(ANIM_MAGIC));
+	header[4] = ANIM_VERSION;
+	header[5] = self->rgb[RED];
+	header[6] = self->rgb[GRN];
+	header[7] = self->rgb[BLU];
+	put_u32(header + 8, (uint32_t)self->num_led);
+	put_u32(header + 12, (uint32_t)(fps * 1000 + 0.5));
+	if (fwrite(header, 1, ANIM_HEADER_BYTES, self->rec_file) != ANIM_HEADER_BYTES) {
+		PyErr_SetFromErrno(PyExc_OSError);
+		record_stop_internal(self);
+		return NULL;
+	}
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(apa102_stop_recording_doc,
+	"stop_recording()\n\n"
+	"finishes the file started by record()\n"
+	"returns how many frames were recorded");
+static PyObject * apa102_stop_recording(apa102Object *self, PyObject *args)
+{
+	uint64_t frames = self->rec_frames;
+	int failed = (self->rec_file != NULL && fflush(self->rec_file) != 0);
+	record_stop_internal(self);
+	if (failed)
+		return PyErr_SetFromErrno(PyExc_OSError);
+	return PyLong_FromUnsignedLongLong(frames);
+}
+
+//copies count leds from src to where led start is stored, going around the ring if needed
+void copy_to_ring(apa102Object *self, Py_ssize_t start, const byte *src, Py_ssize_t count) {
+	Py_ssize_t index = start + self->head;
+	if (index >= self->num_led)
+		index -= self->num_led;
+	Py_ssize_t first = self->num_led - index;
+	if (first > count)
+		first = count;
+	memcpy(self->leds + index*BYTES_PER_LED, src, first*BYTES_PER_LED);
+	memcpy(self->leds, src + first*BYTES_PER_LED, (count - first)*BYTES_PER_LED);
+}
+
+//decodes one frame's payload into leds, returns -1 if the payload doesn't make sense
+int play_frame_internal(apa102Object *self, byte kind, const byte *payload, Py_ssize_t len) {
+	if (kind == ANIM_RAW) {
+		if (len != self->num_led_array)
+			return -1;
+		copy_to_ring(self, 0, payload, self->num_led);
+		mark_dirty(self, 0, self->num_led);
+		return 0;
+	}
+	if (kind != ANIM_DELTA)
+		return -1;
+	const byte *end = payload + len;
+	Py_ssize_t led_num = 0;
+	while (payload < end) {
+		uint64_t skip, count;
+		payload = get_varint(payload, end, &skip);
+		if (payload == NULL)
+			return -1;
+		payload = get_varint(payload, end, &count);
+		//both are checked against the leds left before they are used as Py_ssize_t
+		if (payload == NULL || skip > (uint64_t)(self->num_led - led_num) || count > (uint64_t)(self->num_led - led_num) - skip
+				|| count*BYTES_PER_LED > (uint64_t)(end - payload))
+			return -1;
+		led_num += skip;
+		copy_to_ring(self, led_num, payload, count);
+		mark_dirty(self, led_num, led_num + count);
+		led_num += count;
+		payload += count*BYTES_PER_LED;
+	}
+	return 0;
+}
+
+PyDoc_STRVAR(apa102_play_doc,
+	"play(path, [loop=False], [fps])\n\n"
+	"shows every frame of a file made by record() at the rate it was recorded at, the file is memory mapped so nothing is loaded first\n"
+	"the file has to be recorded with the same num_led and order as this strip\n"
+	"optional- loop the recording until interrupted (with Ctrl+C), or an fps to play it at instead of the recorded one\n"
+	"returns how many frames were played");
+static PyObject * apa102_play(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"path", "loop", "fps", NULL};
+	static const char *types = "O&|pd:play";
+	PyObject *path = NULL;
+	int loop = 0;
+	double fps = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, PyUnicode_FSConverter, &path, &loop, &fps))
+		return NULL;
+	
+	int fd = open(PyBytes_AS_STRING(path), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		PyErr_SetFromErrnoWithFilename(PyExc_OSError, PyBytes_AS_STRING(path));
+		Py_DECREF(path);
+		return NULL;
+	}
+	Py_DECREF(path);
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		PyErr_SetFromErrno(PyExc_OSError);
+		close(fd);
+		return NULL;
+	}
+	if (st.st_size < ANIM_HEADER_BYTES) {
+		close(fd);
+		PyErr_SetString(PyExc_ValueError, "not an animation recorded by record()");
+		return NULL;
+	}
+	const byte *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return PyErr_SetFromErrno(PyExc_OSError);
+	madvise((void*)data, st.st_size, MADV_SEQUENTIAL);
+	const byte *end = data + st.st_size;
+	
+	PyObject *result = NULL;
+	if (memcmp(data, ANIM_MAGIC, sizeof(ANIM_MAGIC)) != 0 || *(data+4) != ANIM_VERSION) {
+		PyErr_SetString(PyExc_ValueError, "not an animation recorded by record()");
+		goto done;
+	}
+	if (get_u32(data + 8) != (uint32_t)self->num_led) {
+		PyErr_Format(PyExc_ValueError, "animation was recorded with %u leds, not %d", get_u32(data + 8), self->num_led);
+		goto done;
+	}
+	if (*(data+5) != self->rgb[RED] || *(data+6) != self->rgb[GRN] || *(data+7) != self->rgb[BLU]) {
+		PyErr_SetString(PyExc_ValueError, "animation was recorded with a different order");
+		goto done;
+	}
+	if (fps <= 0)
+		fps = get_u32(data + 12) / 1000.0;
+	uint64_t period = (fps > 0) ? (uint64_t)(1e9 / fps) : 0;
+	
+	//frames are drawn on layer 0, under any other layers
+	int selected_layer = self->current_layer;
+	if (selected_layer != 0 && self->exports > 0) {
+		PyErr_SetString(PyExc_BufferError, "cannot play while a layer other than 0 is exported");
+		goto done;
+	}
+	lock_range(self, 0, self->num_led);
+	select_layer_internal(self, 0);
+	unlock_range(self, 0, self->num_led);
+	uint64_t frames = 0;
+	uint64_t deadline = monotonic_ns();
+	const byte *pos = data + ANIM_HEADER_BYTES;
+	while (1) {
+		if (pos == end) {
+			if (!loop || frames == 0)
+				break;
+			pos = data + ANIM_HEADER_BYTES;
+		}
+		uint32_t len;
+		int bad = (end - pos < ANIM_FRAME_HEADER_BYTES || (len = get_u32(pos + 1)) > (uint64_t)(end - pos - ANIM_FRAME_HEADER_BYTES));
+		if (!bad) {
+			lock_range(self, 0, self->num_led);
+			bad = play_frame_internal(self, *pos, pos + ANIM_FRAME_HEADER_BYTES, len) < 0;
+			unlock_range(self, 0, self->num_led);
+		}
+		if (bad) {
+			PyErr_SetString(PyExc_ValueError, "animation file is corrupt");
+			goto restore;
+		}
+		pos += ANIM_FRAME_HEADER_BYTES + len;
+		
+		if (PyErr_CheckSignals() < 0)
+			goto restore;
+		if (sleep_until_internal(deadline) < 0)
+			goto restore;
+		deadline += period;
+		if (show_internal(self, 0) < 0)
+			goto restore;
+		frames++;
+	}
+	result = PyLong_FromUnsignedLongLong(frames);
+restore:
+	lock_range(self, 0, self->num_led);
+	select_layer_internal(self, selected_layer);
+	unlock_range(self, 0, self->num_led);
+done:
+	munmap((void*)data, st.st_size);
+	return result;
+}
+
+//network receiver: listen() starts a thread that takes pixels from lighting control packets and puts them straight into leds.
+//packets are read and decoded without the GIL, which is only taken to copy the pixels in and call show()
+enum {NET_E131, NET_ARTNET, NET_DDP, NET_OPC};
+static const char *NET_PROTOCOLS[] = {"e131", "artnet", "ddp", "opc", NULL};
+static const int NET_PORTS[] = {5568, 6454, 4048, 7890};
+#define NET_SYNC_TIMEOUT 4000000000ull //E1.31 and Art-Net go back to showing every frame 4s after the last sync packet
+#define NET_RCVBUF (1 << 20) //a big socket buffer so bursts of universes aren't dropped while show() runs
+
+static const byte E131_ID[12] = {'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0};
+static const byte ARTNET_ID[8] = {'A', 'r', 't', '-', 'N', 'e', 't', 0};
+
+//what a packet asks for: channels (red, green, and blue of each pixel from the first led listened to) to set, then maybe a show
+typedef struct {
+	Py_ssize_t channel;
+	const byte *data;
+	Py_ssize_t len;
+	int show;
+	int sync; //set for sync packets, from then on only they show frames
+} net_update;
+
+static inline uint32_t get_be16(const byte *data) {
+	return (data[0] << 8) | data[1];
+}
+static inline uint32_t get_be32(const byte *data) {
+	return ((uint32_t)data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+//a universe's channels in the strip, show is set for the last universe the strip covers
+static int net_universe(apa102Object *self, int universe, const byte *data, Py_ssize_t len, net_update *up) {
+	int index = universe - self->net_universe;
+	if (index < 0 || index >= self->net_universes)
+		return -1;
+	up->channel = (Py_ssize_t)index * self->net_universe_size;
+	up->data = data;
+	up->len = (len < self->net_universe_size) ? len : self->net_universe_size;
+	up->show = (index == self->net_universes - 1);
+	return 0;
+}
+
+//decodes a packet, returns -1 if it isn't one for this strip
+static int net_decode(apa102Object *self, const byte *packet, Py_ssize_t len, net_update *up) {
+	memset(up, 0, sizeof(net_update));
+	switch (self->net_protocol) {
+		case NET_E131:
+			if (len < 49 || memcmp(packet + 4, E131_ID, sizeof(E131_ID)) != 0)
+				return -1;
+			if (get_be32(packet + 18) == 8 && get_be32(packet + 40) == 1) {
+				//synchronization packet
+				up->show = up->sync = 1;
+				return 0;
+			}
+			//data packets have to be version 4, DMP set property, not preview data, with a 0 start code
+			if (len < 126 || get_be32(packet + 18) != 4 || get_be32(packet + 40) != 2 || packet[117] != 2 || (packet[112] & 0x80) || packet[125] != 0)
+				return -1;
+			{
+				Py_ssize_t count = get_be16(packet + 123) - 1;
+				if (count > len - 126)
+					count = len - 126;
+				if (net_universe(self, get_be16(packet + 113), packet + 126, count, up) < 0)
+					return -1;
+				//a sync address means the frame is shown when the sync packet comes
+				if (get_be16(packet + 109) != 0)
+					up->show = 0;
+			}
+			return 0;
+		case NET_ARTNET:
+			if (len < 10 || memcmp(packet, ARTNET_ID, sizeof(ARTNET_ID)) != 0)
+				return -1;
+			if (packet[8] == 0x00 && packet[9] == 0x52) {
+				//ArtSync
+				up->show = up->sync = 1;
+				return 0;
+			}
+			if (len < 18 || packet[8] != 0x00 || packet[9] != 0x50)
+				return -1;
+			{
+				Py_ssize_t count = get_be16(packet + 16);
+				if (count > len - 18)
+					count = len - 18;
+				return net_universe(self, ((packet[15] & 0x7F) << 8) | packet[14], packet + 18, count, up);
+			}
+		case NET_DDP: {
+			//version 1 data packets to the default output (1) or every output (255)
+			byte flags = packet[0];
+			Py_ssize_t header = (flags & 0x10) ? 14 : 10;
+			if (len < header || (flags & 0xC0) != 0x40 || (flags & 0x06) || (packet[3] != 1 && packet[3] != 255))
+				return -1;
+			//the offset is 32 bits from the network, it is checked before it goes anywhere near a Py_ssize_t
+			uint32_t offset = get_be32(packet + 4);
+			up->data = packet + header;
+			up->len = get_be16(packet + 8);
+			if (up->len > len - header)
+				up->len = len - header;
+			up->show = flags & 0x01;
+			if ((uint64_t)offset >= (uint64_t)(self->num_led - self->net_start) * 3) {
+				//past the strip: nothing to set, but a push without data still shows
+				if (up->len > 0)
+					return -1;
+				offset = 0;
+			}
+			up->channel = offset;
+			return 0;
+		}
+		case NET_OPC:
+			//set pixel colors, on channel 0 (every strip) or ours
+			if (len < 4 || packet[1] != 0 || (packet[0] != 0 && packet[0] != self->net_universe))
+				return -1;
+			up->data = packet + 4;
+			up->len = len - 4;
+			up->show = 1;
+			return 0;
+	}
+	return -1;
+}
+
+//copies a decoded packet into leds and shows it if it asks to, needs the GIL
+static void net_apply(apa102Object *self, const net_update *up) {
+	Py_ssize_t num_channels = (Py_ssize_t)(self->num_led - self->net_start) * 3;
+	Py_ssize_t len = up->len;
+	if (up->channel < 0 || up->channel >= num_channels)
+		len = 0;
+	else if (len > num_channels - up->channel)
+		len = num_channels - up->channel;
+	if (len > 0) {
+		Py_ssize_t first = self->net_start + up->channel / 3, last = self->net_start + (up->channel + len - 1) / 3 + 1;
+		byte bright_byte = get_bright_byte(self, MAX_BRIGHTNESS);
+		lock_range(self, first, last);
+		//a packet doesn't have to start or end on a whole pixel
+		for (Py_ssize_t i = 0; i < len; i++) {
+			Py_ssize_t channel = up->channel + i;
+			byte *ptr = led_ptr(self, self->net_start + channel / 3);
+			*ptr = bright_byte;
+			*(ptr + self->rgb[channel % 3]) = up->data[i];
+		}
+		mark_dirty(self, first, last);
+		unlock_range(self, first, last);
+	}
+	self->net_packets++;
+	//a strip that isn't threaded can't start another frame while show() is sending one without the GIL,
+	//the leds stay dirty and go out with the next frame
+	if (!up->show || !self->net_show || (!self->threaded && self->transmitting))
+		return;
+	int sent = show_internal(self, 0);
+	if (sent < 0 && self->net_error == NULL) {
+		//keep the first error to raise from stop_listening()
+		PyObject *type, *traceback;
+		PyErr_Fetch(&type, &self->net_error, &traceback);
+		PyErr_NormalizeException(&type, &self->net_error, &traceback);
+		if (traceback != NULL)
+			PyException_SetTraceback(self->net_error, traceback);
+		Py_XDECREF(type);
+		Py_XDECREF(traceback);
+	}
+	PyErr_Clear();
+	if (sent > 0)
+		self->net_frames++;
+}
+
+//the largest OPC message plus its header
+#define OPC_MAX_MESSAGE (4 + 65535)
+
+static void * net_worker(void *arg) {
+	apa102Object *self = (apa102Object*)arg;
+	byte *buf = PyMem_RawMalloc(OPC_MAX_MESSAGE);
+	if (buf == NULL)
+		return NULL;
+	int client = -1; //the OPC connection being read
+	Py_ssize_t have = 0; //bytes of the OPC message so far
+	uint64_t last_sync = 0;
+	for (;;) {
+		struct pollfd fds[3] = {{self->net_wake[0], POLLIN, 0}, {self->net_fd, POLLIN, 0}, {client, POLLIN, 0}};
+		if (poll(fds, (client >= 0) ? 3 : 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (fds[0].revents)
+			break;
+		
+		Py_ssize_t len = 0;
+		if (self->net_protocol == NET_OPC) {
+			if (fds[1].revents & POLLIN) {
+				//one sender at a time, a new connection takes over
+				int accepted = accept(self->net_fd, NULL, NULL);
+				if (accepted >= 0) {
+					if (client >= 0)
+						close(client);
+					client = accepted;
+					have = 0;
+				}
+				continue;
+			}
+			if (client < 0 || !fds[2].revents)
+				continue;
+			Py_ssize_t want = (have < 4) ? 4 - have : 4 + (Py_ssize_t)get_be16(buf + 2) - have;
+			ssize_t got = recv(client, buf + have, want, 0);
+			if (got <= 0) {
+				close(client);
+				client = -1;
+				have = 0;
+				continue;
+			}
+			have += got;
+			if (have < 4 || have < 4 + (Py_ssize_t)get_be16(buf + 2))
+				continue;
+			len = have;
+			have = 0;
+		}
+		else {
+			if (!(fds[1].revents & POLLIN))
+				continue;
+			ssize_t got = recv(self->net_fd, buf, OPC_MAX_MESSAGE, 0);
+			if (got <= 0)
+				continue;
+			len = got;
+		}
+		
+		net_update up;
+		if (net_decode(self, buf, len, &up) < 0)
+			continue;
+		//once there are sync packets, only they show frames
+		uint64_t now = monotonic_ns();
+		if (up.sync)
+			last_sync = now;
+		else if (last_sync != 0 && now - last_sync < NET_SYNC_TIMEOUT && self->net_protocol != NET_DDP)
+			up.show = 0;
+		PyGILState_STATE gstate = PyGILState_Ensure();
+		net_apply(self, &up);
+		PyGILState_Release(gstate);
+	}
+	if (client >= 0)
+		close(client);
+	PyMem_RawFree(buf);
+	return NULL;
+}
+
+//stops the receiver thread and closes its socket, needs the GIL, which is let go while waiting for the thread
+void net_stop_internal(apa102Object *self) {
+	if (!self->net_running)
+		return;
+	byte wake = 0;
+	if (write(self->net_wake[1], &wake, 1) < 0) {
+		//the pipe can't be full, nothing else writes to it
+	}
+	Py_BEGIN_ALLOW_THREADS
+	pthread_join(self->net_thread, NULL);
+	Py_END_ALLOW_THREADS
+	close(self->net_fd);
+	close(self->net_wake[0]);
+	close(self->net_wake[1]);
+	self->net_fd = -1;
+	self->net_running = 0;
+}
+
+//raises (and clears) an error show() ran into on the receiver thread, returns -1 if there was one
+static int net_check_error(apa102Object *self) {
+	if (self->net_error == NULL)
+		return 0;
+	PyErr_SetObject((PyObject*)Py_TYPE(self->net_error), self->net_error);
+	Py_CLEAR(self->net_error);
+	return -1;
+}
+
+PyDoc_STRVAR(apa102_listen_doc,
+	"listen(protocol, [port], [host=\"0.0.0.0\"], [universe], [universe_size=510], [start=0], [show=True])\n\n"
+	"starts a thread that receives pixels over the network and puts them straight into the strip, returns the port listened on\n"
+	"\tprotocol -- \"e131\" (sACN), \"artnet\", \"ddp\" (all UDP), or \"opc\" (Open Pixel Control over TCP)\n"
+	"\tport -- defaults to the protocol's usual port (5568, 6454, 4048, or 7890), 0 picks a free one\n"
+	"\thost -- the IPv4 address to listen on\n"
+	"\tuniverse -- the first E1.31 (default 1) or Art-Net (default 0) universe, later ones follow on down the strip,\n"
+	"\t\tor the OPC channel to take besides 0 (default 1)\n"
+	"\tuniverse_size -- how many channels of each universe are used, 510 fits 170 pixels\n"
+	"\tstart -- the led the first pixel received goes to\n"
+	"\tshow -- if True, frames are shown when they are complete: on sync packets if the sender uses them,\n"
+	"\t\tafter the last universe the strip covers otherwise, when DDP sets the push flag, and after every OPC message\n"
+	"colors are received as red, green, blue and sent in the strip's order. only one listen() can run at a time,\n"
+	"calling it again stops the last one first");
+static PyObject * apa102_listen(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"protocol", "port", "host", "universe", "universe_size", "start", "show", NULL};
+	static const char *types = "s|isiiip:listen";
+	const char *protocol_name, *host = "0.0.0.0";
+	int port = -1, universe = -1, universe_size = 510, start = 0, show = 1;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &protocol_name, &port, &host, &universe, &universe_size, &start, &show))
+		return NULL;
+	int protocol = -1;
+	for (int i = 0; NET_PROTOCOLS[i] != NULL; i++) {
+		if (strcmp(protocol_name, NET_PROTOCOLS[i]) == 0)
+			protocol = i;
+	}
+	if (protocol < 0) {
+		PyErr_SetString(PyExc_ValueError, "protocol must be \"e131\", \"artnet\", \"ddp\", or \"opc\"");
+		return NULL;
+	}
+	if (port < -1 || port > 65535) {
+		PyErr_SetString(PyExc_ValueError, "port must be from 0 to 65535");
+		return NULL;
+	}
+	if (universe_size < 1 || universe_size > 512) {
+		PyErr_SetString(PyExc_ValueError, "universe_size must be from 1 to 512");
+		return NULL;
+	}
+	if (start < 0 || start > self->num_led) {
+		PyErr_SetString(PyExc_ValueError, "start must be a led of the strip");
+		return NULL;
+	}
+	if (self->leds == NULL) {
+		PyErr_SetString(PyExc_RuntimeError, "APA102 object is not initialized");
+		return NULL;
+	}
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((port >= 0) ? port : NET_PORTS[protocol]);
+	if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+		PyErr_SetString(PyExc_ValueError, "host must be an IPv4 address");
+		return NULL;
+	}
+	if (universe < 0)
+		universe = (protocol == NET_ARTNET) ? 0 : 1;
+	
+	net_stop_internal(self);
+	Py_CLEAR(self->net_error);
+	int fd = socket(AF_INET, ((protocol == NET_OPC) ? SOCK_STREAM : SOCK_DGRAM) | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return PyErr_SetFromErrno(PyExc_OSError);
+	int on = 1, rcvbuf = NET_RCVBUF;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	socklen_t addr_len = sizeof(addr);
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || (protocol == NET_OPC && listen(fd, 1) < 0)
+			|| getsockname(fd, (struct sockaddr*)&addr, &addr_len) < 0 || pipe(self->net_wake) < 0) {
+		PyErr_SetFromErrno(PyExc_OSError);
+		close(fd);
+		return NULL;
+	}
+	
+	self->net_fd = fd;
+	self->net_protocol = protocol;
+	self->net_universe = universe;
+	self->net_universe_size = universe_size;
+	self->net_start = start;
+	self->net_show = show;
+	self->net_packets = 0;
+	self->net_frames = 0;
+	//how many universes it takes to cover the strip from start on
+	self->net_universes = ((Py_ssize_t)(self->num_led - start) * 3 + universe_size - 1) / universe_size;
+	if (protocol == NET_E131) {
+		//senders often multicast to 239.255.<universe>, joining is allowed to fail (no multicast route, too many groups)
+		for (int i = 0; i < self->net_universes && universe + i <= 63999; i++) {
+			struct ip_mreq group;
+			group.imr_multiaddr.s_addr = htonl(0xEFFF0000 | (universe + i));
+			group.imr_interface.s_addr = htonl(INADDR_ANY);
+			if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &group, sizeof(group)) < 0)
+				break;
+		}
+	}
+#if PY_VERSION_HEX < 0x03070000
+	PyEval_InitThreads();
+#endif
+	int err = pthread_create(&self->net_thread, NULL, net_worker, self);
+	if (err) {
+		close(fd);
+		close(self->net_wake[0]);
+		close(self->net_wake[1]);
+		self->net_fd = -1;
+		errno = err;
+		return PyErr_SetFromErrno(PyExc_OSError);
+	}
+	self->net_running = 1;
+	return PyLong_FromLong(ntohs(addr.sin_port));
+}
+
+PyDoc_STRVAR(apa102_stop_listening_doc,
+	"stop_listening()\n\n"
+	"stops the thread started by listen(), raises any error show() ran into on it\n"
+	"returns how many packets were put into the strip and how many frames were shown as a tuple");
+static PyObject * apa102_stop_listening(apa102Object *self, PyObject *args)
+{
+	net_stop_internal(self);
+	if (net_check_error(self) < 0)
+		return NULL;
+	return Py_BuildValue("KK", (unsigned long long)self->net_packets, (unsigned long long)self->net_frames);
+}
+
+//shared memory frames: attach_shm() maps a POSIX shared memory segment holding one frame, so separate processes can draw
+//frames and one of them can send them. writers publish the frame show() would send, readers encode from the segment straight into wire
+#define SHM_SPINS 1000 //how many times to check seq before giving up the cpu while another process writes
+#define SHM_STALE_NS 1000000000ull //a frame that stays half written this long was left by a process that stopped
+
+//leds start to end of the shared frame into wire, as a render job
+static void shm_slice(apa102Object *self, const void *arg, Py_ssize_t start, Py_ssize_t end) {
+	byte *wire = (byte*)arg;
+	encode_range(self, wire + START_FRAME_BYTES + start*BYTES_PER_LED, self->shm + SHM_HEADER_BYTES + start*BYTES_PER_LED, end - start);
+}
+
+//encodes the newest whole frame in shared memory into wire, trying again if a writer changed it part way through
+//returns 0, or -1 with an exception set if a writer never finished its frame
+int shm_read_internal(apa102Object *self, byte *wire) {
+	shm_header *header = (shm_header*)self->shm;
+	uint32_t stuck = 0;
+	uint64_t deadline = 0;
+	for (int spins = 0;; spins++) {
+		uint32_t before = __atomic_load_n(&header->seq, __ATOMIC_ACQUIRE);
+		if (!(before & 1)) {
+			render_range(self, shm_slice, wire, 0, self->num_led);
+			//the frame has to be read before seq is checked again
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (__atomic_load_n(&header->seq, __ATOMIC_RELAXED) == before) {
+				self->shm_seq = before;
+				return 0;
+			}
+			continue;
+		}
+		if (spins < SHM_SPINS)
+			continue;
+		sched_yield();
+		uint64_t now = monotonic_ns();
+		if (deadline == 0 || before != stuck) {
+			stuck = before;
+			deadline = now + SHM_STALE_NS;
+		}
+		else if (now > deadline) {
+			PyErr_SetString(PyExc_RuntimeError, "a process stopped part way through writing the shared memory frame");
+			return -1;
+		}
+	}
+}
+
+//copies the leds of a frame (without its start and end frames) into shared memory, waiting for other writers
+//returns 0, or -1 with an exception set if another writer that is still running held the frame too long
+int shm_write_internal(apa102Object *self, const segment *segs, int count) {
+	shm_header *header = (shm_header*)self->shm;
+	uint32_t seq, stuck = 0;
+	uint64_t deadline = 0;
+	for (int spins = 0;; spins++) {
+		seq = __atomic_load_n(&header->seq, __ATOMIC_RELAXED);
+		if (!(seq & 1)) {
+			if (__atomic_compare_exchange_n(&header->seq, &seq, seq + 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+				seq++;
+				break;
+			}
+			continue;
+		}
+		if (spins < SHM_SPINS)
+			continue;
+		sched_yield();
+		uint64_t now = monotonic_ns();
+		if (deadline == 0 || seq != stuck) {
+			stuck = seq;
+			deadline = now + SHM_STALE_NS;
+		}
+		else if (now > deadline) {
+			//only take over from a writer that is known to be gone, one that was just stopped or swapped out
+			//would carry on writing pixels after readers took the new frame. seq stays odd until this frame is done
+			pid_t writer = __atomic_load_n(&header->writer, __ATOMIC_RELAXED);
+			if (writer <= 0 || kill(writer, 0) == 0 || errno != ESRCH) {
+				PyErr_SetString(PyExc_RuntimeError, "another process has been writing the shared memory frame for too long");
+				return -1;
+			}
+			if (__atomic_compare_exchange_n(&header->seq, &seq, seq + 2, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+				seq += 2;
+				break;
+			}
+			deadline = 0;
+		}
+	}
+	__atomic_store_n(&header->writer, (int32_t)getpid(), __ATOMIC_RELAXED);
+	//readers have to see seq go odd before any of the frame changes
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	byte *dst = self->shm + SHM_HEADER_BYTES;
+	Py_ssize_t skip = START_FRAME_BYTES, left = self->num_led_array;
+	for (int i = 0; i < count && left > 0; i++) {
+		const byte *src = segs[i].data;
+		Py_ssize_t len = segs[i].len;
+		if (skip >= len) {
+			skip -= len;
+			continue;
+		}
+		src += skip;
+		len -= skip;
+		skip = 0;
+		if (len > left)
+			len = left;
+		memcpy(dst, src, len);
+		dst += len;
+		left -= len;
+	}
+	header->frames++;
+	__atomic_store_n(&header->writer, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&header->seq, seq + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+//unmaps the shared memory, needs the GIL
+void shm_detach_internal(apa102Object *self) {
+	if (self->shm == NULL)
+		return;
+	munmap(self->shm, self->shm_len);
+	self->shm = NULL;
+	self->shm_len = 0;
+	self->shm_mode = SHM_NONE;
+	Py_CLEAR(self->shm_name);
+}
+
+PyDoc_STRVAR(apa102_attach_shm_doc,
+	"attach_shm(name, [mode=\"r\"])\n\n"
+	"maps the POSIX shared memory frame name (made if it doesn't exist yet) so other processes can draw the frames this strip sends\n"
+	"\tmode -- \"r\" makes show() send the newest whole frame in shared memory instead of the strip's own pixels and layers,\n"
+	"\t\tencoding it straight into the frame that goes out. show() only sends a frame when a new one has been written unless force is True\n"
+	"\t\t\"w\" makes show(), show_async(), and present() write the frame to shared memory instead of sending it\n"
+	"any number of processes can attach to the same name, as long as their strips have the same num_led\n"
+	"the frame is a 64 byte header then num_led 4 byte pixels laid out like the buffer. the uint32 at byte 12 of the header is\n"
+	"a seqlock: writers make it odd, write the pixels, and make it even again, so frames are never sent half written.\n"
+	"the int32 at byte 24 is the pid of the writer holding it, a writer that exits part way through a frame is taken over\n"
+	"from, but one that is still running and holds the frame for over a second makes the other writers' show() raise RuntimeError");
+static PyObject * apa102_attach_shm(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"name", "mode", NULL};
+	static const char *types = "U|s:attach_shm";
+	PyObject *name;
+	const char *mode_name = "r";
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &name, &mode_name))
+		return NULL;
+	int mode;
+	if (strcmp(mode_name, "r") == 0)
+		mode = SHM_READ;
+	else if (strcmp(mode_name, "w") == 0)
+		mode = SHM_WRITE;
+	else {
+		PyErr_SetString(PyExc_ValueError, "mode must be \"r\" or \"w\"");
+		return NULL;
+	}
+	if (self->leds == NULL) {
+		PyErr_SetString(PyExc_RuntimeError, "APA102 object is not initialized");
+		return NULL;
+	}
+	if (PyUnicode_GET_LENGTH(name) == 0) {
+		PyErr_SetString(PyExc_ValueError, "name can't be empty");
+		return NULL;
+	}
+	//shm_open names start with a slash
+	PyObject *path = PyUnicode_FromFormat("%s%U", (PyUnicode_READ_CHAR(name, 0) == '/') ? "" : "/", name);
+	if (path == NULL)
+		return NULL;
+	PyObject *path_bytes;
+	if (!PyUnicode_FSConverter(path, &path_bytes)) {
+		Py_DECREF(path);
+		return NULL;
+	}
+	Py_DECREF(path);
+	
+	size_t len = SHM_HEADER_BYTES + self->num_led_array;
+	int fd = shm_open(PyBytes_AS_STRING(path_bytes), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		PyErr_SetFromErrnoWithFilename(PyExc_OSError, PyBytes_AS_STRING(path_bytes));
+		Py_DECREF(path_bytes);
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0 || (st.st_size == 0 && ftruncate(fd, len) < 0)) {
+		PyErr_SetFromErrno(PyExc_OSError);
+		close(fd);
+		Py_DECREF(path_bytes);
+		return NULL;
+	}
+	if (st.st_size != 0 && (size_t)st.st_size != len) {
+		PyErr_Format(PyExc_ValueError, "shared memory %s is not a frame of %d leds", PyBytes_AS_STRING(path_bytes), self->num_led);
+		close(fd);
+		Py_DECREF(path_bytes);
+		return NULL;
+	}
+	byte *shm = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (shm == MAP_FAILED) {
+		PyErr_SetFromErrno(PyExc_OSError);
+		Py_DECREF(path_bytes);
+		return NULL;
+	}
+	shm_header *header = (shm_header*)shm;
+	static const char empty[sizeof(SHM_MAGIC)] = {0};
+	if (memcmp(header->magic, empty, sizeof(empty)) == 0) {
+		//a new segment, every process that finds it empty writes the same header
+		header->num_led = self->num_led;
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		memcpy(header->magic, SHM_MAGIC, sizeof(SHM_MAGIC));
+	}
+	else if (memcmp(header->magic, SHM_MAGIC, sizeof(SHM_MAGIC)) != 0 || header->num_led != (uint32_t)self->num_led) {
+		PyErr_Format(PyExc_ValueError, "shared memory %s is not a frame of %d leds", PyBytes_AS_STRING(path_bytes), self->num_led);
+		munmap(shm, len);
+		Py_DECREF(path_bytes);
+		return NULL;
+	}
+	
+	//frames already queued by show_async() go out the way they were meant to
+	async_wait_internal(self, NULL);
+	lock_show(self);
+	shm_detach_internal(self);
+	self->shm = shm;
+	self->shm_len = len;
+	self->shm_mode = mode;
+	self->shm_name = path_bytes;
+	//odd, so the frame in shared memory is sent by the next show()
+	self->shm_seq = UINT32_MAX;
+	unlock_show(self);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(apa102_detach_shm_doc,
+	"detach_shm([unlink=False])\n\n"
+	"goes back to sending the strip's own pixels\n"
+	"\tunlink -- if True the shared memory name is removed too, processes still attached keep using it");
+static PyObject * apa102_detach_shm(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"unlink", NULL};
+	static const char *types = "|p:detach_shm";
+	int unlink = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &unlink))
+		return NULL;
+	if (self->shm == NULL)
+		Py_RETURN_NONE;
+	async_wait_internal(self, NULL);
+	if (unlink && shm_unlink(PyBytes_AS_STRING(self->shm_name)) < 0 && errno != ENOENT)
+		return PyErr_SetFromErrnoWithFilename(PyExc_OSError, PyBytes_AS_STRING(self->shm_name));
+	lock_show(self);
+	shm_detach_internal(self);
+	//the strip's own pixels haven't been sent for a while
+	mark_dirty(self, 0, self->num_led);
+	unlock_show(self);
+	Py_RETURN_NONE;
+}
+
+static int compare_u64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+PyDoc_STRVAR(apa102_get_frame_stats_doc,
+	"get_frame_stats()\n\n"
+	"returns a dict about the frames shown by present():\n"
+	"\tframes, late, and dropped -- how many frames were shown, late, and skipped\n"
+	"\ttarget_fps -- what set_target_fps set\n"
+	"\tinterval_mean, interval_max, interval_p50, interval_p90, interval_p99 --\n"
+	"\t\tthe time between frames in seconds over the last 256 frames");
+static PyObject * apa102_get_frame_stats(apa102Object *self, PyObject *args)
+{
+	int count = self->pace_interval_count;
+	uint64_t sorted[PACE_INTERVALS];
+	uint64_t total = 0;
+	memcpy(sorted, self->pace_intervals, count * sizeof(uint64_t));
+	qsort(sorted, count, sizeof(uint64_t), compare_u64);
+	for (int i = 0; i < count; i++)
+		total += sorted[i];
+	
+	double mean = 0, max = 0, p50 = 0, p90 = 0, p99 = 0;
+	if (count > 0) {
+		mean = total / 1e9 / count;
+		max = sorted[count-1] / 1e9;
+		p50 = sorted[(count-1) * 50 / 100] / 1e9;
+		p90 = sorted[(count-1) * 90 / 100] / 1e9;
+		p99 = sorted[(count-1) * 99 / 100] / 1e9;
+	}
+	return Py_BuildValue("{s:K,s:K,s:K,s:d,s:d,s:d,s:d,s:d,s:d}",
+		"frames", (unsigned long long)self->pace_frames,
+		"late", (unsigned long long)self->pace_late,
+		"dropped", (unsigned long long)self->pace_dropped,
+		"target_fps", (self->pace_period != 0) ? 1e9 / self->pace_period : 0.0,
+		"interval_mean", mean,
+		"interval_max", max,
+		"interval_p50", p50,
+		"interval_p90", p90,
+		"interval_p99", p99);
+}
+
+PyDoc_STRVAR(apa102_reset_frame_stats_doc,
+	"reset_frame_stats()\n\n"
+	"sets everything returned by get_frame_stats back to 0");
+static PyObject * apa102_reset_frame_stats(apa102Object *self, PyObject *args)
+{
+	self->pace_frames = 0;
+	self->pace_late = 0;
+	self->pace_dropped = 0;
+	self->pace_interval_count = 0;
+	self->pace_interval_pos = 0;
+	self->pace_last_present = 0;
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(apa102_enable_stats_doc,
+	"enable_stats([enabled=True])\n\n"
+	"starts or stops keeping the counters in the stats attribute, while they are off nothing is timed or counted");
+static PyObject * apa102_enable_stats(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"enabled", NULL};
+	static const char *types = "|p:enable_stats";
+	int enabled = 1;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &enabled))
+		return NULL;
+	pthread_mutex_lock(&self->async_lock);
+	self->stats_enabled = enabled;
+	pthread_mutex_unlock(&self->async_lock);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(apa102_reset_stats_doc,
+	"reset_stats()\n\n"
+	"sets every counter in the stats attribute back to 0");
+static PyObject * apa102_reset_stats(apa102Object *self, PyObject *args)
+{
+	self->stat_frames = 0;
+	self->stat_bytes = 0;
+	self->stat_encode_ns = 0;
+	self->stat_write_ns = 0;
+	self->stat_latency_max = 0;
+	self->stat_latency_total = 0;
+	self->stat_set_calls = 0;
+	pthread_mutex_lock(&self->async_lock);
+	self->stat_async_frames = 0;
+	self->stat_async_bytes = 0;
+	self->stat_async_write_ns = 0;
+	pthread_mutex_unlock(&self->async_lock);
+	Py_RETURN_NONE;
+}
+
+static const char HEX_CHARS[] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
+static const char NUMBER_SIGN = '#', NULL_CHAR = '\0';
+
+PyDoc_STRVAR(apa102_get_pixel_color_str_doc,
+	"get_pixel_color_str(led_num)\n\n"
+	"returns the color of the requested pixel as a string in the format \"RRGGBB\"\n"
+	"or None if led_num is out of range");
+static PyObject * apa102_get_pixel_color_str(apa102Object *self, PyObject *arg) {
+	int led_num;
+	if (fast_int(arg, &led_num) < 0)
+		return NULL;
+	
+	if(led_num < 0 || led_num >= self->num_led)
+		Py_RETURN_NONE;
+	
+	lock_range(self, led_num, led_num+1);
+	byte *start_ptr = led_ptr(self, led_num);
+	char str[8];
+	str[0] = NUMBER_SIGN;
+	str[7] = NULL_CHAR;
+	byte b = 0;
+	for (int i = 0; i < BYTES_PER_LED-1; i++) {
+		b = *(start_ptr+self->rgb[i]);
+		str[i*2+2] = HEX_CHARS[b&15];
+		str[i*2+1] = HEX_CHARS[(b>>4)&15];
+	}
+	unlock_range(self, led_num, led_num+1);
+	PyObject* returnObj =  PyUnicode_FromString(&str[0]);
+	return returnObj;
+}
+
+PyDoc_STRVAR(apa102_get_pixel_color_rgb_doc,
 	"get_pixel_color_rgb(led_num)\n\n"
 	"returns the color of the requested pixel as a long in the format 0xRRGGBB\n"
 	"or None if led_num is out of range");
-static PyObject * apa102_get_pixel_color_rgb(apa102Object *self, PyObject *args) {
+static PyObject * apa102_get_pixel_color_rgb(apa102Object *self, PyObject *arg) {
 	int led_num;
-	static const char *types = "i:get_pixel_color_rgb";
-	PyArg_ParseTuple(args, types, &led_num);
-	if(led_num < 0 || led_num > self->num_led)
+	if (fast_int(arg, &led_num) < 0)
+		return NULL;
+	if(led_num < 0 || led_num >= self->num_led)
 			Py_RETURN_NONE;
 	
-	byte r = *(self->leds + led_num*BYTES_PER_LED + self->rgb[RED]);
-	byte g = *(self->leds + led_num*BYTES_PER_LED + self->rgb[GRN]);
-	byte b = *(self->leds + led_num*BYTES_PER_LED + self->rgb[BLU]);
+	lock_range(self, led_num, led_num+1);
+	byte *start_ptr = led_ptr(self, led_num);
+	byte r = *(start_ptr + self->rgb[RED]);
+	byte g = *(start_ptr + self->rgb[GRN]);
+	byte b = *(start_ptr + self->rgb[BLU]);
+	unlock_range(self, led_num, led_num+1);
 	long color = (r << 16) | (g << 8) | b;
 	return PyLong_FromLong(color);
 }
@@ -393,16 +4278,19 @@ PyDoc_STRVAR(apa102_get_pixel_color_doc,
 	"get_pixel_color_tuple(led_num)\n\n"
 	"returns the color of the requested pixel as a tuple of 3 numbers in the format (R, G, B)\n"
 	"or None if led_num is out of range");
-static PyObject * apa102_get_pixel_color(apa102Object *self, PyObject *args) {
+static PyObject * apa102_get_pixel_color(apa102Object *self, PyObject *arg) {
 	int led_num;
-	static const char *types = "i:get_pixel_color";
-	PyArg_ParseTuple(args, types, &led_num);
-	if(led_num < 0 || led_num > self->num_led)
+	if (fast_int(arg, &led_num) < 0)
+		return NULL;
+	if(led_num < 0 || led_num >= self->num_led)
 			Py_RETURN_NONE;
 	
-	byte r = *(self->leds + led_num*BYTES_PER_LED + self->rgb[RED]);
-	byte g = *(self->leds + led_num*BYTES_PER_LED + self->rgb[GRN]);
-	byte b = *(self->leds + led_num*BYTES_PER_LED + self->rgb[BLU]);
+	lock_range(self, led_num, led_num+1);
+	byte *start_ptr = led_ptr(self, led_num);
+	byte r = *(start_ptr + self->rgb[RED]);
+	byte g = *(start_ptr + self->rgb[GRN]);
+	byte b = *(start_ptr + self->rgb[BLU]);
+	unlock_range(self, led_num, led_num+1);
 	PyObject* tuple = PyTuple_New(3);
 	PyTuple_SetItem(tuple, 0, PyLong_FromLong((long)r));
 	PyTuple_SetItem(tuple, 1, PyLong_FromLong((long)g));
@@ -418,7 +4306,8 @@ static PyObject * apa102_combine_color(apa102Object *self, PyObject *args, PyObj
 		static char *kwlist[] = {"red", "green", "blue", NULL};
 		static const char *types = "bbb:combine_color";	
 		unsigned char r, g, b;
-		PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &r, &g, &b);
+		if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &r, &g, &b))
+			return NULL;
 		long rgb = (r << 16) | (g << 8) | b;
 		return PyLong_FromLong(rgb);
 }
@@ -430,55 +4319,37 @@ PyDoc_STRVAR(apa102_rotate_doc,
 static PyObject * apa102_rotate(apa102Object *self, PyObject *args) {
 		static const char *types = "|i:rotate";	
 		int signed_pos = 1;
-		PyArg_ParseTuple(args, types, &signed_pos);
+		if (!PyArg_ParseTuple(args, types, &signed_pos))
+			return NULL;
+		if (self->num_led == 0)
+			Py_RETURN_NONE;
 		
 		//make sure number of shifts is less than the number of leds
-		signed_pos %= self->num_led;
+		Py_ssize_t pos = signed_pos % self->num_led;
+		if (pos < 0)
+			pos += self->num_led;
 		
-		if (signed_pos == 0)
+		if (pos == 0)
 			Py_RETURN_NONE;
+		//every led moves, so every segment is locked
+		PyThreadState *save = lock_pixels(self, 0, self->num_led, (self->exports > 0) ? self->num_led : 0);
+		mark_dirty(self, 0, self->num_led);
 		
-		int8_t direction = (signed_pos < 0) ? -1 : 1;
-		int pos = abs(signed_pos);
-		
-		//if it takes less work to shift in the other direction, do that instead
-		if (pos > self->num_led/2) {
-			pos = self->num_led - signed_pos;
-			direction *= -1;
+		//nothing is moved, led 0 just starts [pos] leds further into the ring
+		self->head += pos;
+		if (self->head >= self->num_led)
+			self->head -= self->num_led;
+		//in indexed mode show() fills the leds in again from the indices, so they have to turn too
+		if (self->indices != NULL) {
+			reverse_indices(self->indices, pos);
+			reverse_indices(self->indices + pos, self->num_led - pos);
+			reverse_indices(self->indices, self->num_led);
 		}
 		
-		pos *= BYTES_PER_LED;
-		int *temp = PyMem_Calloc(pos, sizeof(byte));
-		
-		if (direction > 0) {
-			//store first [pos] elements in an array
-			for (int i = 0; i < pos; i++) {
-				*(temp+i) = *(self->leds+i);
-			}
-			//shift the other values over:
-			for (int i = 0; i < self->num_led_array-pos; i++) {
-				*(self->leds+i) = *(self->leds+i+pos);
-			}
-			//put the temp values in the end of the array
-			for (int i = 0; i < pos; i++) {
-				*(self->leds+self->num_led_array-pos+i) = *(temp+i);
-			}
-		}
-		else {
-			//store last [pos] elements in an array
-			for (int i = 0; i < pos; i++) {
-				*(temp+i) = *(self->leds+self->num_led_array-pos+i);
-			}
-			//shift the other values over:
-			for (int i = self->num_led_array-1; i > pos; i--) {
-				*(self->leds+i) = *(self->leds+i-pos);
-			}
-			//put the temp values in the begining of the array
-			for (int i = 0; i < pos; i++) {
-				*(self->leds+i) = *(temp+i);
-			}
-		}
-		PyMem_Free(temp);
+		//buffers see the leds where they are stored, so while one is out they have to actually move
+		if (self->exports > 0)
+			normalize_ring(self);
+		unlock_pixels(self, 0, self->num_led, save);
 		Py_RETURN_NONE;
 }
 
@@ -488,22 +4359,254 @@ PyDoc_STRVAR(apa102_wheel_doc,
 static PyObject * apa102_wheel(apa102Object *self, PyObject *args) {
 		static const char *types = "b:wheel";	
 		unsigned char pos = 1;
-		PyArg_ParseTuple(args, types, &pos);
-		//Get a color from a color wheel; Green -> Red -> Blue -> Green
-		long rgb;
-		if (pos < 85){  //Green -> Red
-			pos *= 3;
-			rgb = (pos << 16) | ((255-pos) << 8);
-		}
-		else if (pos < 170){  // Red -> Blue
-			pos = (pos - 85)*3;
-			rgb = ((255-pos) << 16) | pos;
+		if (!PyArg_ParseTuple(args, types, &pos))
+			return NULL;
+		return PyLong_FromLong(wheel_internal(pos));
+}
+
+//effects: each one fills a whole range in one call, writing the leds the same way set_pixel does
+
+//clamps start and end to the strip, end < 0 means the end of the strip. returns 0 if the range is empty
+int clamp_range(apa102Object *self, int *start, int *end) {
+	if (*end < 0 || *end > self->num_led)
+		*end = self->num_led;
+	if (*start < 0)
+		*start = 0;
+	return *start < *end;
+}
+
+//render jobs for the effects, every pixel's color only depends on how far it is from first
+typedef struct {
+	Py_ssize_t first;
+	uint32_t pos;
+	int32_t step;
+	byte bright_byte;
+} rainbow_job;
+static void rainbow_slice(apa102Object *self, const void *arg, Py_ssize_t start, Py_ssize_t end) {
+	const rainbow_job *job = (const rainbow_job*)arg;
+	uint32_t pos = job->pos + (uint32_t)job->step * (uint32_t)(start - job->first);
+	byte r, g, b;
+	for (Py_ssize_t i = start; i < end; i++) {
+		get_rgb_internal(wheel_internal((byte)(pos >> 8)), &r, &g, &b);
+		write_pixel_internal(self, i, r, g, b, job->bright_byte);
+		pos += job->step;
+	}
+}
+
+typedef struct {
+	Py_ssize_t first;
+	int steps;
+	byte rgb0[3];
+	byte rgb1[3];
+	byte bright_byte;
+} gradient_job;
+static void gradient_slice(apa102Object *self, const void *arg, Py_ssize_t start, Py_ssize_t end) {
+	const gradient_job *job = (const gradient_job*)arg;
+	int steps = job->steps;
+	for (Py_ssize_t led = start; led < end; led++) {
+		int i = led - job->first;
+		write_pixel_internal(self, led,
+			(job->rgb0[RED] * (steps - i) + job->rgb1[RED] * i + steps/2) / steps,
+			(job->rgb0[GRN] * (steps - i) + job->rgb1[GRN] * i + steps/2) / steps,
+			(job->rgb0[BLU] * (steps - i) + job->rgb1[BLU] * i + steps/2) / steps,
+			job->bright_byte);
+	}
+}
+
+//arg points to the scale
+static void fade_slice(apa102Object *self, const void *arg, Py_ssize_t start, Py_ssize_t end) {
+	uint32_t scale = *(const uint32_t*)arg;
+	byte *ptr = self->leds + start*BYTES_PER_LED;
+	for (Py_ssize_t i = start; i < end; i++) {
+		*(ptr+1) = (*(ptr+1) * scale) >> 8;
+		*(ptr+2) = (*(ptr+2) * scale) >> 8;
+		*(ptr+3) = (*(ptr+3) * scale) >> 8;
+		ptr += BYTES_PER_LED;
+	}
+}
+
+PyDoc_STRVAR(apa102_fill_rainbow_doc,
+	"fill_rainbow([start=0], [end=-1], [hue_offset=0], [step=None], [brightness=31])\n\n"
+	"fills the pixels from start (inclusive) to end (exclusive, -1 for the end of the strip) with the colors from wheel()\n"
+	"the first pixel gets wheel(hue_offset) and each one after moves step positions further around the wheel\n"
+	"step can be a fraction, if it is None the range shows the whole wheel once\n"
+	"optional- include a brightness to display the pixels at (from 0 to 31 inclusive)");
+static PyObject * apa102_fill_rainbow(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"start", "end", "hue_offset", "step", "brightness", NULL};
+	static const char *types = "|iiiOb:fill_rainbow";
+	int start = 0, end = -1, hue_offset = 0;
+	PyObject *step_obj = Py_None;
+	unsigned char led_brightness = MAX_BRIGHTNESS;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &start, &end, &hue_offset, &step_obj, &led_brightness))
+		return NULL;
+	if (!clamp_range(self, &start, &end))
+		Py_RETURN_NONE;
+	
+	//positions are kept in 1/256ths of a wheel position so step can be a fraction
+	int32_t step;
+	if (step_obj == Py_None)
+		step = 65536 / (end - start);
+	else {
+		double step_d = PyFloat_AsDouble(step_obj);
+		if (step_d == -1.0 && PyErr_Occurred())
+			return NULL;
+		step = (int32_t)(step_d * 256);
+	}
+	
+	rainbow_job job = {start, (uint32_t)hue_offset << 8, step, get_bright_byte(self, led_brightness)};
+	PyThreadState *save = lock_pixels(self, start, end, end - start);
+	mark_dirty(self, start, end);
+	render_range(self, rainbow_slice, &job, start, end);
+	unlock_pixels(self, start, end, save);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(apa102_fill_gradient_doc,
+	"fill_gradient(start, end, start_rgb, end_rgb, [brightness=31])\n\n"
+	"fills the pixels from start (inclusive) to end (exclusive, -1 for the end of the strip) with colors fading\n"
+	"from start_rgb to end_rgb (both in the format 0xRRGGBB)\n"
+	"optional- include a brightness to display the pixels at (from 0 to 31 inclusive)");
+static PyObject * apa102_fill_gradient(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"start", "end", "start_rgb", "end_rgb", "brightness", NULL};
+	static const char *types = "iiii|b:fill_gradient";
+	int start, end, start_rgb, end_rgb;
+	unsigned char led_brightness = MAX_BRIGHTNESS;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &start, &end, &start_rgb, &end_rgb, &led_brightness))
+		return NULL;
+	if (!clamp_range(self, &start, &end))
+		Py_RETURN_NONE;
+	
+	gradient_job job;
+	job.first = start;
+	//the last pixel gets end_rgb exactly
+	job.steps = (end - start > 1) ? end - start - 1 : 1;
+	get_rgb_internal(start_rgb, &job.rgb0[RED], &job.rgb0[GRN], &job.rgb0[BLU]);
+	get_rgb_internal(end_rgb, &job.rgb1[RED], &job.rgb1[GRN], &job.rgb1[BLU]);
+	job.bright_byte = get_bright_byte(self, led_brightness);
+	PyThreadState *save = lock_pixels(self, start, end, end - start);
+	mark_dirty(self, start, end);
+	render_range(self, gradient_slice, &job, start, end);
+	unlock_pixels(self, start, end, save);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(apa102_chase_doc,
+	"chase(rgb, [spacing=3], [offset=0], [background=0], [brightness=31])\n\n"
+	"sets every spacing-th pixel (starting at offset) to rgb and the rest to background (both in the format 0xRRGGBB)\n"
+	"call it with offset going up by one every frame to make the lights move down the strip\n"
+	"optional- include a brightness to display the pixels at (from 0 to 31 inclusive)");
+static PyObject * apa102_chase(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"rgb", "spacing", "offset", "background", "brightness", NULL};
+	static const char *types = "i|iiib:chase";
+	int rgb, spacing = 3, offset = 0, background = 0;
+	unsigned char led_brightness = MAX_BRIGHTNESS;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &rgb, &spacing, &offset, &background, &led_brightness))
+		return NULL;
+	if (spacing < 1) {
+		PyErr_SetString(PyExc_ValueError, "spacing must be at least 1");
+		return NULL;
+	}
+	
+	byte r, g, b, back_r, back_g, back_b;
+	get_rgb_internal(rgb, &r, &g, &b);
+	get_rgb_internal(background, &back_r, &back_g, &back_b);
+	byte bright_byte = get_bright_byte(self, led_brightness);
+	//count is how many pixels until the next lit one
+	int count = offset % spacing;
+	if (count < 0)
+		count += spacing;
+	PyThreadState *save = lock_pixels(self, 0, self->num_led, self->num_led);
+	mark_dirty(self, 0, self->num_led);
+	for (int i = 0; i < self->num_led; i++) {
+		if (count == 0) {
+			write_pixel_internal(self, i, r, g, b, bright_byte);
+			count = spacing;
 		}
-		else { // Blue -> Green
-			pos = (pos-170)*3;
-			rgb = (pos << 8) | (255-pos);
+		else
+			write_pixel_internal(self, i, back_r, back_g, back_b, bright_byte);
+		count--;
+	}
+	unlock_pixels(self, 0, self->num_led, save);
+	Py_RETURN_NONE;
+}
+
+//xorshift32, good enough for deciding which pixels twinkle
+static inline uint32_t next_random(apa102Object *self) {
+	uint32_t x = self->random_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	self->random_state = x;
+	return x;
+}
+
+PyDoc_STRVAR(apa102_twinkle_doc,
+	"twinkle([chance=0.05], [rgb=0xFFFFFF], [brightness=31], [seed=None])\n\n"
+	"turns each pixel to rgb (in the format 0xRRGGBB) with the given chance (from 0 to 1), leaving the others as they are\n"
+	"call fade_to_black before it every frame to make the pixels fade out again\n"
+	"seed restarts the random numbers so the same twinkles can be repeated\n"
+	"optional- include a brightness to display the pixels at (from 0 to 31 inclusive)");
+static PyObject * apa102_twinkle(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"chance", "rgb", "brightness", "seed", NULL};
+	static const char *types = "|dibO:twinkle";
+	double chance = 0.05;
+	int rgb = 0xFFFFFF;
+	unsigned char led_brightness = MAX_BRIGHTNESS;
+	PyObject *seed = Py_None;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &chance, &rgb, &led_brightness, &seed))
+		return NULL;
+	unsigned long seed_value = 0;
+	if (seed != Py_None) {
+		seed_value = PyLong_AsUnsignedLongMask(seed);
+		if (seed_value == (unsigned long)-1 && PyErr_Occurred())
+			return NULL;
+	}
+	
+	uint32_t threshold = (chance >= 1) ? UINT32_MAX : (uint32_t)(chance * 4294967296.0);
+	byte r, g, b;
+	get_rgb_internal(rgb, &r, &g, &b);
+	byte bright_byte = get_bright_byte(self, led_brightness);
+	//random_state is only used here, the locks keep two threads from using it at once
+	PyThreadState *save = lock_pixels(self, 0, self->num_led, (chance > 0) ? self->num_led : 0);
+	if (seed != Py_None) {
+		//xorshift gets stuck on 0
+		self->random_state = (uint32_t)seed_value ? (uint32_t)seed_value : 1;
+	}
+	if (chance > 0) {
+		for (int i = 0; i < self->num_led; i++) {
+			if (next_random(self) <= threshold) {
+				set_pixel_internal(self, i, r, g, b, bright_byte);
+			}
 		}
-		return PyLong_FromLong(rgb);
+	}
+	unlock_pixels(self, 0, self->num_led, save);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(apa102_fade_to_black_doc,
+	"fade_to_black(amount)\n\n"
+	"dims every pixel's color by amount/256 (from 0 to 255 inclusive), 255 turns them all off");
+static PyObject * apa102_fade_to_black(apa102Object *self, PyObject *args)
+{
+	static const char *types = "b:fade_to_black";
+	unsigned char amount;
+	if (!PyArg_ParseTuple(args, types, &amount))
+		return NULL;
+	if (amount == 0)
+		Py_RETURN_NONE;
+	
+	//every color is scaled the same, so the order they are stored in doesn't matter
+	uint32_t scale = 256 - amount;
+	PyThreadState *save = lock_pixels(self, 0, self->num_led, self->num_led);
+	//the slices are where the leds are stored, not led numbers
+	render_range(self, fade_slice, &scale, 0, self->num_led);
+	mark_dirty(self, 0, self->num_led);
+	unlock_pixels(self, 0, self->num_led, save);
+	Py_RETURN_NONE;
 }
 
 static const char OPEN_BRACKET = '[', CLOSED_BRACKET = ']', SPACE = ' ', COMMA = ',';
@@ -511,21 +4614,29 @@ PyDoc_STRVAR(apa102_dump_array_doc,
 	"dump_array()\n\n"
 	"For debug purposes: Dump the LED array onto the console.");
 static PyObject * apa102_dump_array(apa102Object *self, PyObject *args) {
-		int length = (self->num_led_array*4);
-		char *text = PyMem_Calloc(length, sizeof(char));
+		if (self->num_led == 0) {
+			printf("[]");
+			Py_RETURN_NONE;
+		}
+		Py_ssize_t length = (self->num_led_array*4);
+		char *text = PyMem_Calloc(length+1, sizeof(char));
+		if (text == NULL)
+			return PyErr_NoMemory();
 		*text = OPEN_BRACKET;
 		*(text+length-1) = CLOSED_BRACKET;
-		int offset = 1;
+		Py_ssize_t offset = 1;
 		byte b;
-		for(int i = 0; i < self->num_led_array-1; i++) {
-			b = *(self->leds+i);
+		lock_range(self, 0, self->num_led);
+		for(Py_ssize_t i = 0; i < self->num_led_array-1; i++) {
+			b = *(led_ptr(self, i/BYTES_PER_LED) + i%BYTES_PER_LED);
 			*(text+offset) = HEX_CHARS[b&15];
 			*(text+offset+1) = HEX_CHARS[(b>>4)&15];
 			*(text+offset+2) = COMMA;
 			*(text+offset+3) = SPACE;
 			offset += 4;
 		}
-		b = *(self->leds+self->num_led_array-1);
+		b = *(led_ptr(self, self->num_led-1) + BYTES_PER_LED-1);
+		unlock_range(self, 0, self->num_led);
 		*(text+length-3) = HEX_CHARS[b&15];
 		*(text+length-2) = HEX_CHARS[(b>>4)&15];
 		printf("%s", text);
@@ -547,6 +4658,28 @@ static PyObject * apa102_get_global_brightness(apa102Object *self, void *closure
 	return result;
 }
 
+PyDoc_STRVAR(apa_stats_var_doc,
+	"a dict of counters kept while enable_stats() is on: frames and bytes sent (by show(), present(), play() and the show_async() thread),\n"
+	"ns spent getting frames ready (encode_ns) and writing them (write_ns), the max and average ns show() took (latency_max_ns, latency_avg_ns),\n"
+	"and how many set_* calls were made (set_calls)");
+static PyObject * apa102_get_stats(apa102Object *self, void *closure) {
+	//the worker only holds async_lock while it isn't waiting for the GIL, so this can't deadlock
+	pthread_mutex_lock(&self->async_lock);
+	uint64_t async_frames = self->stat_async_frames;
+	uint64_t async_bytes = self->stat_async_bytes;
+	uint64_t async_write_ns = self->stat_async_write_ns;
+	pthread_mutex_unlock(&self->async_lock);
+	return Py_BuildValue("{s:O,s:K,s:K,s:K,s:K,s:K,s:K,s:K}",
+		"enabled", self->stats_enabled ? Py_True : Py_False,
+		"frames", (unsigned long long)(self->stat_frames + async_frames),
+		"bytes", (unsigned long long)(self->stat_bytes + async_bytes),
+		"encode_ns", (unsigned long long)self->stat_encode_ns,
+		"write_ns", (unsigned long long)(self->stat_write_ns + async_write_ns),
+		"latency_max_ns", (unsigned long long)self->stat_latency_max,
+		"latency_avg_ns", (unsigned long long)(self->stat_frames ? self->stat_latency_total / self->stat_frames : 0),
+		"set_calls", (unsigned long long)self->stat_set_calls);
+}
+
 PyDoc_STRVAR(apa_order_var_doc, "the order red, green, and blue values are sent to the strip (ex: an order of RGB={1,2,3}");
 static PyObject * apa102_get_order(apa102Object *self, void *closure) {
 	PyObject *result = PyList_New(3);
@@ -561,8 +4694,51 @@ PyDoc_STRVAR(apa_write_callback_var_doc, "the function called to write the data
 static PyObject * apa102_get_write_callback(apa102Object *self, void *closure) {
 	if (self->spi_write == NULL)
 		Py_RETURN_NONE;
-	else
-		return self->spi_write;
+	Py_INCREF(self->spi_write);
+	return self->spi_write;
+}
+
+PyDoc_STRVAR(apa_fd_var_doc, "the file descriptor show() writes to, or None if write_callback is used instead");
+static PyObject * apa102_get_fd(apa102Object *self, void *closure) {
+	if (self->fd < 0)
+		Py_RETURN_NONE;
+	return PyLong_FromLong((long)self->fd);
+}
+
+PyDoc_STRVAR(apa_chunk_size_var_doc, "the most bytes sent in one spidev message or write_callback call, 0 for no limit");
+static PyObject * apa102_get_chunk_size(apa102Object *self, void *closure) {
+	return PyLong_FromSsize_t(self->chunk_size);
+}
+PyDoc_STRVAR(apa_render_threads_var_doc, "how many threads set_render_threads splits big jobs between, 1 if it isn't used");
+static PyObject * apa102_get_render_threads(apa102Object *self, void *closure) {
+	return PyLong_FromLong(self->render_threads);
+}
+
+PyDoc_STRVAR(apa_gamma_var_doc, "the gamma set by set_gamma, or None if a table was given");
+static PyObject * apa102_get_gamma(apa102Object *self, void *closure) {
+	if (self->gamma == 0)
+		Py_RETURN_NONE;
+	return PyFloat_FromDouble(self->gamma);
+}
+
+PyDoc_STRVAR(apa_dimmer_var_doc, "the level set by set_dimmer, from 0 to 255");
+static PyObject * apa102_get_dimmer(apa102Object *self, void *closure) {
+	return PyLong_FromLong((long)self->dimmer);
+}
+
+PyDoc_STRVAR(apa_layer_var_doc, "the layer selected by select_layer");
+static PyObject * apa102_get_layer(apa102Object *self, void *closure) {
+	return PyLong_FromLong((long)self->current_layer);
+}
+
+PyDoc_STRVAR(apa_palette_size_var_doc, "how many colors the palette set by set_palette has, 0 when the strip isn't in indexed mode");
+static PyObject * apa102_get_palette_size(apa102Object *self, void *closure) {
+	return PyLong_FromLong((long)self->palette_len);
+}
+
+PyDoc_STRVAR(apa_num_layers_var_doc, "how many layers there are, including layer 0");
+static PyObject * apa102_get_num_layers(apa102Object *self, void *closure) {
+	return PyLong_FromLong((self->num_layers > 0) ? (long)self->num_layers : 1);
 }
 
 PyDoc_STRVAR(apa_max_brightness_var_doc, "the maximum that the brightness value can be set to");
@@ -571,6 +4747,47 @@ static PyObject * apa102_get_max_brightness(apa102Object *self, void *closure) {
 	return result;
 }
 
+//buffer protocol, exposes leds as a (num_led, 4) array of bytes
+static int apa102_getbuffer(apa102Object *self, Py_buffer *view, int flags) {
+	if (self->leds == NULL) {
+		PyErr_SetString(PyExc_BufferError, "APA102 object is not initialized");
+		view->obj = NULL;
+		return -1;
+	}
+	//the buffer has led 0 first
+	lock_range(self, 0, self->num_led);
+	normalize_ring(self);
+	unlock_range(self, 0, self->num_led);
+	view->obj = (PyObject*)self;
+	Py_INCREF(self);
+	view->buf = self->leds;
+	view->len = self->num_led_array;
+	view->readonly = 0;
+	view->itemsize = 1;
+	view->format = (flags & PyBUF_FORMAT) ? "B" : NULL;
+	if (flags & PyBUF_ND) {
+		view->ndim = 2;
+		view->shape = self->shape;
+	}
+	else {
+		view->ndim = 1;
+		view->shape = NULL;
+	}
+	view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? self->strides : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+	self->exports++;
+	return 0;
+}
+static void apa102_releasebuffer(apa102Object *self, Py_buffer *view) {
+	self->exports--;
+}
+
+static PyBufferProcs apa102_as_buffer = {
+	(getbufferproc)apa102_getbuffer,
+	(releasebufferproc)apa102_releasebuffer,
+};
+
 //actual declarations at end of file so they are easier to find
 static PyMethodDef apa102_methods[];
 static PyGetSetDef apa102_getset[];
@@ -597,7 +4814,7 @@ static PyTypeObject apa102_Type = {
 	0,                          /*tp_str*/
 	0, /*tp_getattro*/
 	0,                          /*tp_setattro*/
-	0,                          /*tp_as_buffer*/
+	&apa102_as_buffer,          /*tp_as_buffer*/
 	Py_TPFLAGS_DEFAULT,         /*tp_flags*/
 	0,                          /*tp_doc*/
 	0,                          /*tp_traverse*/
@@ -616,11 +4833,652 @@ static PyTypeObject apa102_Type = {
 	0,                          /*tp_dictoffset*/
 	(initproc)apa102_init,      /*tp_init*/
 	0,                          /*tp_alloc*/
+	apa102_new,                 /*tp_new*/
+	0,                          /*tp_free*/
+	0,                          /*tp_is_gc*/
+};
+
+/* Timeline: keyframes of colors that are interpolated and drawn into an APA102 object */
+
+PyDoc_STRVAR(timeline_doc,
+	"Timeline(num_led, [loop=False])\n\n"
+	"holds keyframes (colors for a range of pixels at a time in seconds) and draws the frame for any time into an APA102 object\n"
+	"each pixel fades from the last keyframe that covers it to the next one that covers it\n"
+	"\tnum_led -- how many leds the keyframes cover\n"
+	"\tloop (optional) -- if True, times past the last keyframe start over from 0");
+
+enum {EASE_LINEAR, EASE_STEP, EASE_IN, EASE_OUT, EASE_IN_OUT};
+static const char *EASINGS[] = {"linear", "step", "ease_in", "ease_out", "ease_in_out", NULL};
+
+typedef struct {
+	double time;
+	int start;
+	int count;
+	int easing; //how the fade into this keyframe goes
+	byte *rgb; //count packed red, green, blue pixels
+} keyframe;
+
+typedef struct {
+	PyObject_HEAD
+	keyframe *keyframes; //sorted by time
+	Py_ssize_t num_keyframes;
+	Py_ssize_t keyframes_size;
+	int num_led;
+	int loop;
+} timelineObject;
+
+static PyTypeObject timeline_Type;
+
+//returns how far (from 0 to 65536) a fade is at fraction of the way through
+static int32_t ease_internal(int easing, double fraction) {
+	switch (easing) {
+		case EASE_STEP:
+			fraction = 0;
+			break;
+		case EASE_IN:
+			fraction = fraction * fraction;
+			break;
+		case EASE_OUT:
+			fraction = 1 - (1 - fraction) * (1 - fraction);
+			break;
+		case EASE_IN_OUT:
+			fraction = fraction * fraction * (3 - 2 * fraction);
+			break;
+	}
+	return (int32_t)(fraction * 65536);
+}
+
+static inline int keyframe_covers(const keyframe *k, int led_num) {
+	return led_num >= k->start && led_num < k->start + k->count;
+}
+
+static int timeline_init(timelineObject *self, PyObject *args, PyObject *keywds) {
+	static char *kwlist[] = {"num_led", "loop", NULL};
+	static const char *types = "i|p:__init__";
+	int num_led, loop = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &num_led, &loop))
+		return -1;
+	if (num_led < 0) {
+		PyErr_SetString(PyExc_ValueError, "num_led must not be negative");
+		return -1;
+	}
+	for (Py_ssize_t i = 0; i < self->num_keyframes; i++)
+		PyMem_Free(self->keyframes[i].rgb);
+	self->num_keyframes = 0;
+	self->num_led = num_led;
+	self->loop = loop;
+	return 0;
+}
+
+static void timeline_dealloc(timelineObject *self) {
+	for (Py_ssize_t i = 0; i < self->num_keyframes; i++)
+		PyMem_Free(self->keyframes[i].rgb);
+	PyMem_Free(self->keyframes);
+	Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+PyDoc_STRVAR(timeline_add_keyframe_doc,
+	"add_keyframe(time, colors, [start=0], [end=-1], [easing=\"linear\"])\n\n"
+	"adds a keyframe at time (in seconds)\n"
+	"\tcolors -- either one color in the format 0xRRGGBB for the pixels from start (inclusive) to end (exclusive, -1 for all of them),\n"
+	"\t\tor a buffer of packed red, green, blue bytes for the pixels from start on\n"
+	"\teasing -- how pixels fade into this keyframe: \"linear\", \"step\" (no fade), \"ease_in\", \"ease_out\", or \"ease_in_out\"");
+static PyObject * timeline_add_keyframe(timelineObject *self, PyObject *args, PyObject *keywds) {
+	static char *kwlist[] = {"time", "colors", "start", "end", "easing", NULL};
+	static const char *types = "dO|iis:add_keyframe";
+	double time;
+	PyObject *colors;
+	int start = 0, end = -1;
+	const char *easing_name = EASINGS[EASE_LINEAR];
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &time, &colors, &start, &end, &easing_name))
+		return NULL;
+	
+	int easing = -1;
+	for (int i = 0; EASINGS[i] != NULL; i++) {
+		if (strcmp(easing_name, EASINGS[i]) == 0)
+			easing = i;
+	}
+	if (easing < 0) {
+		PyErr_SetString(PyExc_ValueError, "easing must be \"linear\", \"step\", \"ease_in\", \"ease_out\", or \"ease_in_out\"");
+		return NULL;
+	}
+	if (start < 0)
+		start = 0;
+	
+	keyframe k;
+	k.time = time;
+	k.start = start;
+	k.easing = easing;
+	if (PyLong_Check(colors)) {
+		long rgb = PyLong_AsLong(colors);
+		if (rgb == -1 && PyErr_Occurred())
+			return NULL;
+		if (end < 0 || end > self->num_led)
+			end = self->num_led;
+		k.count = (end > start) ? end - start : 0;
+		k.rgb = PyMem_Malloc(k.count*3 + 1);
+		if (k.rgb == NULL)
+			return PyErr_NoMemory();
+		for (int i = 0; i < k.count; i++)
+			get_rgb_internal(rgb, k.rgb + i*3, k.rgb + i*3 + 1, k.rgb + i*3 + 2);
+	}
+	else {
+		Py_buffer buffer;
+		if (PyObject_GetBuffer(colors, &buffer, PyBUF_SIMPLE) < 0)
+			return NULL;
+		if (buffer.len % 3 != 0) {
+			PyBuffer_Release(&buffer);
+			PyErr_SetString(PyExc_ValueError, "colors buffer length must be a multiple of 3");
+			return NULL;
+		}
+		k.count = buffer.len / 3;
+		if (k.count > self->num_led - start)
+			k.count = (self->num_led > start) ? self->num_led - start : 0;
+		k.rgb = PyMem_Malloc(k.count*3 + 1);
+		if (k.rgb == NULL) {
+			PyBuffer_Release(&buffer);
+			return PyErr_NoMemory();
+		}
+		memcpy(k.rgb, buffer.buf, k.count*3);
+		PyBuffer_Release(&buffer);
+	}
+	
+	if (self->num_keyframes == self->keyframes_size) {
+		Py_ssize_t size = self->keyframes_size ? self->keyframes_size*2 : 8;
+		keyframe *keyframes = PyMem_Realloc(self->keyframes, size*sizeof(keyframe));
+		if (keyframes == NULL) {
+			PyMem_Free(k.rgb);
+			return PyErr_NoMemory();
+		}
+		self->keyframes = keyframes;
+		self->keyframes_size = size;
+	}
+	//keyframes at the same time stay in the order they were added
+	Py_ssize_t index = self->num_keyframes;
+	while (index > 0 && self->keyframes[index-1].time > time)
+		index--;
+	memmove(self->keyframes + index + 1, self->keyframes + index, (self->num_keyframes - index)*sizeof(keyframe));
+	self->keyframes[index] = k;
+	self->num_keyframes++;
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(timeline_clear_doc,
+	"clear()\n\n"
+	"removes every keyframe");
+static PyObject * timeline_clear(timelineObject *self, PyObject *args) {
+	for (Py_ssize_t i = 0; i < self->num_keyframes; i++)
+		PyMem_Free(self->keyframes[i].rgb);
+	self->num_keyframes = 0;
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(timeline_render_doc,
+	"render(strip, time, [brightness=31])\n\n"
+	"draws the frame at time (in seconds) into strip, an APA102 object, then call strip.show() to display it\n"
+	"pixels no keyframe has reached yet are left as they are\n"
+	"optional- include a brightness to display the pixels at (from 0 to 31 inclusive)");
+static PyObject * timeline_render(timelineObject *self, PyObject *args, PyObject *keywds) {
+	static char *kwlist[] = {"strip", "time", "brightness", NULL};
+	static const char *types = "O!d|b:render";
+	apa102Object *strip;
+	double time;
+	unsigned char led_brightness = MAX_BRIGHTNESS;
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &apa102_Type, &strip, &time, &led_brightness))
+		return NULL;
+	if (self->num_keyframes == 0 || strip->leds == NULL)
+		Py_RETURN_NONE;
+	
+	double duration = self->keyframes[self->num_keyframes-1].time;
+	if (self->loop && duration > 0) {
+		time = fmod(time, duration);
+		if (time < 0)
+			time += duration;
+	}
+	
+	//last keyframe at or before time
+	Py_ssize_t current = self->num_keyframes - 1;
+	while (current >= 0 && self->keyframes[current].time > time)
+		current--;
+	
+	byte bright_byte = get_bright_byte(strip, led_brightness);
+	int num_led = (self->num_led < strip->num_led) ? self->num_led : strip->num_led;
+	int dirty_start = num_led, dirty_end = 0;
+	const keyframe *last_from = NULL, *last_to = NULL;
+	int32_t eased = 0;
+	//keeps the GIL, keyframes could change under it otherwise
+	lock_range(strip, 0, num_led);
+	for (int i = 0; i < num_led; i++) {
+		//the keyframes around time that cover this pixel, usually the first ones looked at
+		const keyframe *from = NULL, *to = NULL;
+		for (Py_ssize_t j = current; j >= 0; j--) {
+			if (keyframe_covers(&self->keyframes[j], i)) {
+				from = &self->keyframes[j];
+				break;
+			}
+		}
+		if (from == NULL)
+			continue;
+		for (Py_ssize_t j = current + 1; j < self->num_keyframes; j++) {
+			if (keyframe_covers(&self->keyframes[j], i)) {
+				to = &self->keyframes[j];
+				break;
+			}
+		}
+		
+		const byte *c0 = from->rgb + (i - from->start)*3;
+		if (to == NULL) {
+			write_pixel_internal(strip, i, c0[0], c0[1], c0[2], bright_byte);
+		}
+		else {
+			if (from != last_from || to != last_to) {
+				eased = ease_internal(to->easing, (time - from->time) / (to->time - from->time));
+				last_from = from;
+				last_to = to;
+			}
+			const byte *c1 = to->rgb + (i - to->start)*3;
+			write_pixel_internal(strip, i,
+				c0[0] + (((c1[0] - c0[0]) * eased) >> 16),
+				c0[1] + (((c1[1] - c0[1]) * eased) >> 16),
+				c0[2] + (((c1[2] - c0[2]) * eased) >> 16),
+				bright_byte);
+		}
+		if (i < dirty_start)
+			dirty_start = i;
+		dirty_end = i + 1;
+	}
+	if (dirty_start < dirty_end)
+		mark_dirty(strip, dirty_start, dirty_end);
+	unlock_range(strip, 0, num_led);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(timeline_duration_var_doc, "the time of the last keyframe");
+static PyObject * timeline_get_duration(timelineObject *self, void *closure) {
+	if (self->num_keyframes == 0)
+		return PyFloat_FromDouble(0);
+	return PyFloat_FromDouble(self->keyframes[self->num_keyframes-1].time);
+}
+
+PyDoc_STRVAR(timeline_num_keyframes_var_doc, "how many keyframes have been added");
+static PyObject * timeline_get_num_keyframes(timelineObject *self, void *closure) {
+	return PyLong_FromSsize_t(self->num_keyframes);
+}
+
+PyDoc_STRVAR(timeline_num_led_var_doc, "the number of leds the keyframes cover");
+static PyObject * timeline_get_num_led(timelineObject *self, void *closure) {
+	return PyLong_FromLong((long)self->num_led);
+}
+
+static PyMethodDef timeline_methods[];
+static PyGetSetDef timeline_getset[];
+
+static PyTypeObject timeline_Type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"apa102.Timeline",          /*tp_name*/
+	sizeof(timelineObject),     /*tp_basicsize*/
+	0,                          /*tp_itemsize*/
+	/* methods */
+	(destructor)timeline_dealloc, /*tp_dealloc*/
+	0,                          /*tp_print*/
+	0,                          /*tp_getattr*/
+	0,                          /*tp_setattr*/
+	0,                          /*tp_reserved*/
+	0,                          /*tp_repr*/
+	0,                          /*tp_as_number*/
+	0,                          /*tp_as_sequence*/
+	0,                          /*tp_as_mapping*/
+	0,                          /*tp_hash*/
+	0,                          /*tp_call*/
+	0,                          /*tp_str*/
+	0,                          /*tp_getattro*/
+	0,                          /*tp_setattro*/
+	0,                          /*tp_as_buffer*/
+	Py_TPFLAGS_DEFAULT,         /*tp_flags*/
+	timeline_doc,               /*tp_doc*/
+	0,                          /*tp_traverse*/
+	0,                          /*tp_clear*/
+	0,                          /*tp_richcompare*/
+	0,                          /*tp_weaklistoffset*/
+	0,                          /*tp_iter*/
+	0,                          /*tp_iternext*/
+	timeline_methods,           /*tp_methods*/
+	0,                          /*tp_members*/
+	timeline_getset,            /*tp_getset*/
+	0,                          /*tp_base*/
+	0,                          /*tp_dict*/
+	0,                          /*tp_descr_get*/
+	0,                          /*tp_descr_set*/
+	0,                          /*tp_dictoffset*/
+	(initproc)timeline_init,    /*tp_init*/
+	0,                          /*tp_alloc*/
+	PyType_GenericNew,          /*tp_new*/
+	0,                          /*tp_free*/
+	0,                          /*tp_is_gc*/
+};
+
+/* Layout: which led each (x, y) of a matrix of panels is, worked out once for blit */
+
+PyDoc_STRVAR(layout_doc,
+	"Layout(width, height, [wiring=\"rows\"], [tiles_x=1], [tiles_y=1], [tile_wiring=\"rows\"], [rotation=0], [flip_x=False], [flip_y=False])\n\n"
+	"works out once which led every (x, y) of a matrix is, for APA102.blit and index(). (0, 0) is the top left corner\n"
+	"\twidth, height -- the size of one panel in pixels, as it is wired\n"
+	"\twiring -- how the leds run through a panel from its top left corner: \"rows\" (every row left to right),\n"
+	"\t\t\"serpentine\" (rows going back and forth), \"columns\" (every column top to bottom), or \"column_serpentine\"\n"
+	"\ttiles_x, tiles_y (optional) -- how many panels across and down, chained in the order tile_wiring gives (same names as wiring)\n"
+	"\trotation (optional) -- 0, 90, 180, or 270 degrees the picture is turned clockwise on the panels, 90 and 270 swap width and height\n"
+	"\tflip_x, flip_y (optional) -- mirror the picture left to right or top to bottom before it is turned");
+
+enum {WIRE_ROWS, WIRE_SERPENTINE, WIRE_COLUMNS, WIRE_COLUMN_SERPENTINE};
+static const char *WIRINGS[] = {"rows", "serpentine", "columns", "column_serpentine", NULL};
+
+typedef struct {
+	PyObject_HEAD
+	uint32_t *lut; //the led for each pixel, row by row
+	int width; //after rotation
+	int height;
+} layoutObject;
+
+static PyTypeObject layout_Type;
+
+//how far into a width by height grid wired the given way (x, y) is
+static Py_ssize_t wire_order(int wiring, Py_ssize_t width, Py_ssize_t height, Py_ssize_t x, Py_ssize_t y) {
+	switch (wiring) {
+		case WIRE_SERPENTINE:
+			return y*width + ((y & 1) ? width-1-x : x);
+		case WIRE_COLUMNS:
+			return x*height + y;
+		case WIRE_COLUMN_SERPENTINE:
+			return x*height + ((x & 1) ? height-1-y : y);
+		default:
+			return y*width + x;
+	}
+}
+
+//returns the wiring or -1 with an exception set
+static int parse_wiring(const char *name) {
+	for (int i = 0; WIRINGS[i] != NULL; i++) {
+		if (strcmp(name, WIRINGS[i]) == 0)
+			return i;
+	}
+	PyErr_SetString(PyExc_ValueError, "wiring must be \"rows\", \"serpentine\", \"columns\", or \"column_serpentine\"");
+	return -1;
+}
+
+static int layout_init(layoutObject *self, PyObject *args, PyObject *keywds) {
+	static char *kwlist[] = {"width", "height", "wiring", "tiles_x", "tiles_y", "tile_wiring", "rotation", "flip_x", "flip_y", NULL};
+	static const char *types = "ii|siisipp:__init__";
+	int width, height, tiles_x = 1, tiles_y = 1, rotation = 0, flip_x = 0, flip_y = 0;
+	const char *wiring_name = WIRINGS[WIRE_ROWS], *tile_wiring_name = WIRINGS[WIRE_ROWS];
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &width, &height, &wiring_name, &tiles_x, &tiles_y, &tile_wiring_name, &rotation, &flip_x, &flip_y))
+		return -1;
+	//strips hold on to layouts and blit without the GIL when threaded, so the table can't change
+	if (self->lut != NULL) {
+		PyErr_SetString(PyExc_RuntimeError, "a Layout can't be changed once it is made");
+		return -1;
+	}
+	int wiring = parse_wiring(wiring_name);
+	if (wiring < 0)
+		return -1;
+	int tile_wiring = parse_wiring(tile_wiring_name);
+	if (tile_wiring < 0)
+		return -1;
+	if (width < 1 || height < 1 || tiles_x < 1 || tiles_y < 1) {
+		PyErr_SetString(PyExc_ValueError, "width, height, tiles_x, and tiles_y must be at least 1");
+		return -1;
+	}
+	if (rotation != 0 && rotation != 90 && rotation != 180 && rotation != 270) {
+		PyErr_SetString(PyExc_ValueError, "rotation must be 0, 90, 180, or 270");
+		return -1;
+	}
+	//every led number has to fit in an int like num_led
+	int64_t panel = (int64_t)width * height, tiles = (int64_t)tiles_x * tiles_y;
+	if (panel > INT_MAX || tiles > INT_MAX || panel * tiles > INT_MAX || (int64_t)width * tiles_x > INT_MAX || (int64_t)height * tiles_y > INT_MAX) {
+		PyErr_SetString(PyExc_OverflowError, "layout is too large");
+		return -1;
+	}
+	
+	int canvas_w = width * tiles_x, canvas_h = height * tiles_y;
+	int w = (rotation % 180) ? canvas_h : canvas_w;
+	int h = (rotation % 180) ? canvas_w : canvas_h;
+	uint32_t *lut = PyMem_Malloc((size_t)w * h * sizeof(uint32_t));
+	if (lut == NULL) {
+		PyErr_NoMemory();
+		return -1;
+	}
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			int lx = flip_x ? w-1-x : x;
+			int ly = flip_y ? h-1-y : y;
+			//where on the panels the pixel ends up
+			int px, py;
+			switch (rotation) {
+				case 90:
+					px = canvas_w-1-ly;
+					py = lx;
+					break;
+				case 180:
+					px = canvas_w-1-lx;
+					py = canvas_h-1-ly;
+					break;
+				case 270:
+					px = ly;
+					py = canvas_h-1-lx;
+					break;
+				default:
+					px = lx;
+					py = ly;
+			}
+			Py_ssize_t tile = wire_order(tile_wiring, tiles_x, tiles_y, px / width, py / height);
+			lut[(Py_ssize_t)y*w + x] = (uint32_t)(tile*panel + wire_order(wiring, width, height, px % width, py % height));
+		}
+	}
+	self->lut = lut;
+	self->width = w;
+	self->height = h;
+	return 0;
+}
+
+static void layout_dealloc(layoutObject *self) {
+	PyMem_Free(self->lut);
+	Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+PyDoc_STRVAR(layout_index_doc,
+	"index(x, y)\n\n"
+	"returns the led number of the pixel at (x, y), or None if it is off the matrix");
+static PyObject * layout_index(layoutObject *self, PyObject *args) {
+	int x, y;
+	if (!PyArg_ParseTuple(args, "ii:index", &x, &y))
+		return NULL;
+	if (self->lut == NULL || x < 0 || y < 0 || x >= self->width || y >= self->height)
+		Py_RETURN_NONE;
+	return PyLong_FromUnsignedLong(self->lut[(Py_ssize_t)y*self->width + x]);
+}
+
+PyDoc_STRVAR(layout_width_var_doc, "how many pixels across the matrix is, after rotation");
+static PyObject * layout_get_width(layoutObject *self, void *closure) {
+	return PyLong_FromLong(self->width);
+}
+
+PyDoc_STRVAR(layout_height_var_doc, "how many pixels down the matrix is, after rotation");
+static PyObject * layout_get_height(layoutObject *self, void *closure) {
+	return PyLong_FromLong(self->height);
+}
+
+PyDoc_STRVAR(layout_num_led_var_doc, "how many leds the matrix has");
+static PyObject * layout_get_num_led(layoutObject *self, void *closure) {
+	return PyLong_FromSsize_t((Py_ssize_t)self->width * self->height);
+}
+
+static PyMethodDef layout_methods[];
+static PyGetSetDef layout_getset[];
+
+static PyTypeObject layout_Type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"apa102.Layout",            /*tp_name*/
+	sizeof(layoutObject),       /*tp_basicsize*/
+	0,                          /*tp_itemsize*/
+	/* methods */
+	(destructor)layout_dealloc, /*tp_dealloc*/
+	0,                          /*tp_print*/
+	0,                          /*tp_getattr*/
+	0,                          /*tp_setattr*/
+	0,                          /*tp_reserved*/
+	0,                          /*tp_repr*/
+	0,                          /*tp_as_number*/
+	0,                          /*tp_as_sequence*/
+	0,                          /*tp_as_mapping*/
+	0,                          /*tp_hash*/
+	0,                          /*tp_call*/
+	0,                          /*tp_str*/
+	0,                          /*tp_getattro*/
+	0,                          /*tp_setattro*/
+	0,                          /*tp_as_buffer*/
+	Py_TPFLAGS_DEFAULT,         /*tp_flags*/
+	layout_doc,                 /*tp_doc*/
+	0,                          /*tp_traverse*/
+	0,                          /*tp_clear*/
+	0,                          /*tp_richcompare*/
+	0,                          /*tp_weaklistoffset*/
+	0,                          /*tp_iter*/
+	0,                          /*tp_iternext*/
+	layout_methods,             /*tp_methods*/
+	0,                          /*tp_members*/
+	layout_getset,              /*tp_getset*/
+	0,                          /*tp_base*/
+	0,                          /*tp_dict*/
+	0,                          /*tp_descr_get*/
+	0,                          /*tp_descr_set*/
+	0,                          /*tp_dictoffset*/
+	(initproc)layout_init,      /*tp_init*/
+	0,                          /*tp_alloc*/
 	PyType_GenericNew,          /*tp_new*/
 	0,                          /*tp_free*/
 	0,                          /*tp_is_gc*/
 };
 
+//the APA102 functions that use a Layout
+
+PyDoc_STRVAR(apa102_set_layout_doc,
+	"set_layout(layout)\n\n"
+	"sets the Layout blit draws through, or None to remove it");
+static PyObject * apa102_set_layout(apa102Object *self, PyObject *layout) {
+	if (layout != Py_None && !PyObject_TypeCheck(layout, &layout_Type)) {
+		PyErr_SetString(PyExc_TypeError, "layout must be a Layout or None");
+		return NULL;
+	}
+	if (layout != Py_None && ((layoutObject*)layout)->lut == NULL) {
+		PyErr_SetString(PyExc_RuntimeError, "Layout object is not initialized");
+		return NULL;
+	}
+	PyObject *old = self->layout;
+	self->layout = (layout != Py_None) ? layout : NULL;
+	Py_XINCREF(self->layout);
+	Py_XDECREF(old);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(apa102_blit_doc,
+	"blit(image, [x=0], [y=0], [width], [brightness=31], [layout=\"rgb\"])\n\n"
+	"copies image onto the matrix set by set_layout with its top left corner at (x, y), anything off the matrix is skipped\n"
+	"image is a buffer of packed pixels row by row like a (height, width, 3) numpy array, layout is the order of the bytes\n"
+	"in each pixel like set_pixels takes, so a (height, width, 4) array needs a layout like \"rgba\".\n"
+	"width (in pixels) is only needed if image has no shape, like bytes\n"
+	"optional- include a brightness to display the pixels at (from 0 to 31 inclusive)");
+static PyObject * apa102_blit(apa102Object *self, PyObject *args, PyObject *keywds)
+{
+	static char *kwlist[] = {"image", "x", "y", "width", "brightness", "layout", NULL};
+	static const char *types = "O|iinbs:blit";
+	PyObject *image;
+	int x = 0, y = 0;
+	Py_ssize_t width = -1;
+	unsigned char led_brightness = MAX_BRIGHTNESS;
+	const char *pixel_layout = "rgb";
+	if (!PyArg_ParseTupleAndKeywords(args, keywds, types, kwlist, &image, &x, &y, &width, &led_brightness, &pixel_layout))
+		return NULL;
+	count_set_call(self);
+	if (self->layout == NULL) {
+		PyErr_SetString(PyExc_RuntimeError, "set_layout has to be called before blit");
+		return NULL;
+	}
+	byte src_off[3];
+	int stride = parse_layout(pixel_layout, src_off);
+	if (stride == 0) {
+		PyErr_SetString(PyExc_ValueError, "layout must contain r, g, and b once each and at most one a");
+		return NULL;
+	}
+	Py_buffer buffer;
+	if (PyObject_GetBuffer(image, &buffer, PyBUF_C_CONTIGUOUS) < 0)
+		return NULL;
+	PyObject *result = NULL;
+	if (buffer.itemsize != 1) {
+		PyErr_SetString(PyExc_TypeError, "image must be a buffer of bytes");
+		goto done;
+	}
+	//a (height, width, bytes per pixel) array gives its own width, a 2d one is taken as rows of packed pixels
+	if (buffer.ndim > 3 || (buffer.ndim == 3 && buffer.shape[2] != stride) || (buffer.ndim == 2 && buffer.shape[1] % stride != 0)) {
+		PyErr_Format(PyExc_ValueError, "image must be (height, width, %d) or (height, width*%d) for layout \"%s\"", stride, stride, pixel_layout);
+		goto done;
+	}
+	if (width < 0 && buffer.ndim == 3)
+		width = buffer.shape[1];
+	else if (width < 0 && buffer.ndim == 2)
+		width = buffer.shape[1] / stride;
+	if (width < 0) {
+		PyErr_SetString(PyExc_TypeError, "width is needed when image has no shape");
+		goto done;
+	}
+	if (width == 0 || buffer.len % (width*stride) != 0) {
+		PyErr_Format(PyExc_ValueError, "image must be rows of %zd pixels of %d bytes", width, stride);
+		goto done;
+	}
+	Py_ssize_t height = buffer.len / (width*stride);
+	
+	//the part of image that lands on the matrix
+	layoutObject *lay = (layoutObject*)self->layout;
+	Py_INCREF(lay);
+	Py_ssize_t first_col = (x < 0) ? -(Py_ssize_t)x : 0;
+	Py_ssize_t last_col = (lay->width - (Py_ssize_t)x < width) ? lay->width - (Py_ssize_t)x : width;
+	Py_ssize_t first_row = (y < 0) ? -(Py_ssize_t)y : 0;
+	Py_ssize_t last_row = (lay->height - (Py_ssize_t)y < height) ? lay->height - (Py_ssize_t)y : height;
+	byte bright_byte = get_bright_byte(self, led_brightness);
+	Py_ssize_t dirty_start = self->num_led, dirty_end = 0;
+	Py_ssize_t count = (last_col > first_col && last_row > first_row) ? (last_col - first_col) * (last_row - first_row) : 0;
+	PyThreadState *save = lock_pixels(self, 0, self->num_led, count);
+	for (Py_ssize_t row = first_row; row < last_row; row++) {
+		const byte *src = (const byte*)buffer.buf + (row*width + first_col)*stride;
+		const uint32_t *led_nums = lay->lut + (y + row)*lay->width + x + first_col;
+		for (Py_ssize_t col = first_col; col < last_col; col++, src += stride) {
+			uint32_t led_num = *(led_nums++);
+			//the matrix can have more leds than the strip
+			if (led_num >= (uint32_t)self->num_led)
+				continue;
+			write_pixel_internal(self, led_num, *(src + src_off[RED]), *(src + src_off[GRN]), *(src + src_off[BLU]), bright_byte);
+			if (led_num < dirty_start)
+				dirty_start = led_num;
+			if (led_num >= dirty_end)
+				dirty_end = led_num + 1;
+		}
+	}
+	if (dirty_start < dirty_end)
+		mark_dirty(self, dirty_start, dirty_end);
+	unlock_pixels(self, 0, self->num_led, save);
+	Py_DECREF(lay);
+	result = Py_None;
+	Py_INCREF(result);
+done:
+	PyBuffer_Release(&buffer);
+	return result;
+}
+
+PyDoc_STRVAR(apa_layout_var_doc, "the Layout set by set_layout, or None");
+static PyObject * apa102_get_layout(apa102Object *self, void *closure) {
+	PyObject *layout = (self->layout != NULL) ? self->layout : Py_None;
+	Py_INCREF(layout);
+	return layout;
+}
+
 static int apa102_exec(PyObject *m)
 {
 	/* Slot initialization is subject to the rules of initializing globals.
@@ -634,6 +5492,7 @@ static int apa102_exec(PyObject *m)
 	   behavior.
 	*/
 	apa102_Type.tp_base = &PyBaseObject_Type;
+	select_kernels();
 	/* Finalize the type object including setting type of the new type
 	 * object; doing it here is required for portability, too. */
 	if (PyType_Ready(&apa102_Type) < 0)
@@ -652,6 +5511,23 @@ static int apa102_exec(PyObject *m)
 		goto fail;
 	Py_INCREF(&apa102_Type);
 	PyModule_AddObject(m, "APA102", (PyObject *)&apa102_Type);
+	
+	timeline_Type.tp_base = &PyBaseObject_Type;
+	if (PyType_Ready(&timeline_Type) < 0)
+		goto fail;
+	Py_INCREF(&timeline_Type);
+	PyModule_AddObject(m, "Timeline", (PyObject *)&timeline_Type);
+	
+	layout_Type.tp_base = &PyBaseObject_Type;
+	if (PyType_Ready(&layout_Type) < 0)
+		goto fail;
+	
+	//not added to the module, it only backs the memoryviews given to write_callback
+	frameview_Type.tp_base = &PyBaseObject_Type;
+	if (PyType_Ready(&frameview_Type) < 0)
+		goto fail;
+	Py_INCREF(&layout_Type);
+	PyModule_AddObject(m, "Layout", (PyObject *)&layout_Type);
 	return 0;
  fail:
 	Py_XDECREF(m);
@@ -659,6 +5535,8 @@ static int apa102_exec(PyObject *m)
 }
 
 static struct PyModuleDef_Slot apa102_slots[] = {
+	//no Py_mod_gil slot: only strips created with threaded=True lock for themselves, plain strips, Timeline,
+	//and Layout rely on the GIL, so free-threaded builds keep it on while this module is loaded
 	{Py_mod_exec, apa102_exec},
 	{0, NULL},
 };
@@ -684,28 +5562,98 @@ PyInit_apa102(void)
 }
 
 static PyMethodDef apa102_methods[] = {
-	{"set_pixel",				(PyCFunction)apa102_set_pixel,				METH_VARARGS | METH_KEYWORDS,	apa102_set_pixel_doc},
-	{"set_pixel_rgb",			(PyCFunction)apa102_set_pixel_rgb,			METH_VARARGS | METH_KEYWORDS,	apa102_set_pixel_rgb_doc},
+	{"set_pixel",				(PyCFunction)apa102_set_pixel,				METH_FASTCALL | METH_KEYWORDS,	apa102_set_pixel_doc},
+	{"set_pixel_rgb",			(PyCFunction)apa102_set_pixel_rgb,			METH_FASTCALL | METH_KEYWORDS,	apa102_set_pixel_rgb_doc},
 	{"set_range",				(PyCFunction)apa102_set_range,				METH_VARARGS | METH_KEYWORDS,	apa102_set_range_doc},
 	{"set_range_rgb",			(PyCFunction)apa102_set_range_rgb,			METH_VARARGS | METH_KEYWORDS,	apa102_set_range_rgb_doc},
 	{"set_all",					(PyCFunction)apa102_set_all,				METH_VARARGS | METH_KEYWORDS,	apa102_set_all_doc},
 	{"set_all_rgb",				(PyCFunction)apa102_set_all_rgb,			METH_VARARGS | METH_KEYWORDS,	apa102_set_all_rgb_doc},
-	{"show",					(PyCFunction)apa102_show,					METH_VARARGS, 					apa102_show_doc},
+	{"show",					(PyCFunction)apa102_show,					METH_VARARGS | METH_KEYWORDS,	apa102_show_doc},
+	{"set_pixels",				(PyCFunction)apa102_set_pixels,				METH_VARARGS | METH_KEYWORDS,	apa102_set_pixels_doc},
+	{"set_pixels_at",			(PyCFunction)apa102_set_pixels_at,			METH_VARARGS | METH_KEYWORDS,	apa102_set_pixels_at_doc},
+	{"get_pixels_at",			(PyCFunction)apa102_get_pixels_at,			METH_VARARGS | METH_KEYWORDS,	apa102_get_pixels_at_doc},
+	{"set_pixels_hsv",			(PyCFunction)apa102_set_pixels_hsv,			METH_VARARGS | METH_KEYWORDS,	apa102_set_pixels_hsv_doc},
+	{"hsv_to_rgb",				(PyCFunction)apa102_hsv_to_rgb,				METH_O,							apa102_hsv_to_rgb_doc},
+	{"set_palette",				(PyCFunction)apa102_set_palette,			METH_VARARGS | METH_KEYWORDS,	apa102_set_palette_doc},
+	{"set_indices",				(PyCFunction)apa102_set_indices,			METH_VARARGS | METH_KEYWORDS,	apa102_set_indices_doc},
+	{"rotate_palette",			(PyCFunction)apa102_rotate_palette,			METH_VARARGS,					apa102_rotate_palette_doc},
+	{"set_layout",				(PyCFunction)apa102_set_layout,				METH_O,							apa102_set_layout_doc},
+	{"blit",					(PyCFunction)apa102_blit,					METH_VARARGS | METH_KEYWORDS,	apa102_blit_doc},
+	{"show_async",				(PyCFunction)apa102_show_async,				METH_VARARGS | METH_KEYWORDS,	apa102_show_async_doc},
+	{"wait",					(PyCFunction)apa102_wait,					METH_VARARGS | METH_KEYWORDS,	apa102_wait_doc},
+	{"set_async_policy",		(PyCFunction)apa102_set_async_policy,		METH_VARARGS | METH_KEYWORDS,	apa102_set_async_policy_doc},
+	{"set_render_threads",		(PyCFunction)apa102_set_render_threads,		METH_VARARGS | METH_KEYWORDS,	apa102_set_render_threads_doc},
+	{"set_gamma",				(PyCFunction)apa102_set_gamma,				METH_VARARGS | METH_KEYWORDS,	apa102_set_gamma_doc},
+	{"set_dimmer",				(PyCFunction)apa102_set_dimmer,				METH_VARARGS,					apa102_set_dimmer_doc},
+	{"add_layer",				(PyCFunction)apa102_add_layer,				METH_VARARGS | METH_KEYWORDS,	apa102_add_layer_doc},
+	{"select_layer",			(PyCFunction)apa102_select_layer,			METH_VARARGS,					apa102_select_layer_doc},
+	{"set_layer",				(PyCFunction)apa102_set_layer,				METH_VARARGS | METH_KEYWORDS,	apa102_set_layer_doc},
+	{"remove_layers",			(PyCFunction)apa102_remove_layers,			METH_NOARGS, 					apa102_remove_layers_doc},
+	{"set_target_fps",			(PyCFunction)apa102_set_target_fps,			METH_VARARGS | METH_KEYWORDS,	apa102_set_target_fps_doc},
+	{"present",					(PyCFunction)apa102_present,				METH_NOARGS, 					apa102_present_doc},
+	{"get_frame_stats",			(PyCFunction)apa102_get_frame_stats,		METH_NOARGS, 					apa102_get_frame_stats_doc},
+	{"reset_frame_stats",		(PyCFunction)apa102_reset_frame_stats,		METH_NOARGS, 					apa102_reset_frame_stats_doc},
+	{"enable_stats",			(PyCFunction)apa102_enable_stats,			METH_VARARGS | METH_KEYWORDS,	apa102_enable_stats_doc},
+	{"reset_stats",				(PyCFunction)apa102_reset_stats,			METH_NOARGS, 					apa102_reset_stats_doc},
+	{"record",					(PyCFunction)apa102_record,					METH_VARARGS | METH_KEYWORDS,	apa102_record_doc},
+	{"stop_recording",			(PyCFunction)apa102_stop_recording,			METH_NOARGS, 					apa102_stop_recording_doc},
+	{"play",					(PyCFunction)apa102_play,					METH_VARARGS | METH_KEYWORDS,	apa102_play_doc},
+	{"listen",					(PyCFunction)apa102_listen,					METH_VARARGS | METH_KEYWORDS,	apa102_listen_doc},
+	{"stop_listening",			(PyCFunction)apa102_stop_listening,			METH_NOARGS, 					apa102_stop_listening_doc},
+	{"attach_shm",				(PyCFunction)apa102_attach_shm,				METH_VARARGS | METH_KEYWORDS,	apa102_attach_shm_doc},
+	{"detach_shm",				(PyCFunction)apa102_detach_shm,				METH_VARARGS | METH_KEYWORDS,	apa102_detach_shm_doc},
 	{"clear_strip",				(PyCFunction)apa102_clear_strip,			METH_VARARGS,  					apa102_clear_strip_doc},
 	{"rotate",					(PyCFunction)apa102_rotate,					METH_VARARGS,  					apa102_rotate_doc},
-	{"get_pixel_color_str",		(PyCFunction)apa102_get_pixel_color_str,	METH_VARARGS,  					apa102_get_pixel_color_str_doc},
-	{"get_pixel_color_rgb",		(PyCFunction)apa102_get_pixel_color_rgb,	METH_VARARGS,  					apa102_get_pixel_color_rgb_doc},
-	{"get_pixel_color",			(PyCFunction)apa102_get_pixel_color,		METH_VARARGS,  					apa102_get_pixel_color_doc},
+	{"get_pixel_color_str",		(PyCFunction)apa102_get_pixel_color_str,	METH_O,  						apa102_get_pixel_color_str_doc},
+	{"get_pixel_color_rgb",		(PyCFunction)apa102_get_pixel_color_rgb,	METH_O,  						apa102_get_pixel_color_rgb_doc},
+	{"get_pixel_color",			(PyCFunction)apa102_get_pixel_color,		METH_O,  						apa102_get_pixel_color_doc},
 	{"combine_color",			(PyCFunction)apa102_combine_color,			METH_VARARGS | METH_KEYWORDS,	apa102_combine_color_doc},
 	{"wheel",					(PyCFunction)apa102_wheel,					METH_VARARGS,					apa102_wheel_doc},
+	{"fill_rainbow",			(PyCFunction)apa102_fill_rainbow,			METH_VARARGS | METH_KEYWORDS,	apa102_fill_rainbow_doc},
+	{"fill_gradient",			(PyCFunction)apa102_fill_gradient,			METH_VARARGS | METH_KEYWORDS,	apa102_fill_gradient_doc},
+	{"chase",					(PyCFunction)apa102_chase,					METH_VARARGS | METH_KEYWORDS,	apa102_chase_doc},
+	{"twinkle",					(PyCFunction)apa102_twinkle,				METH_VARARGS | METH_KEYWORDS,	apa102_twinkle_doc},
+	{"fade_to_black",			(PyCFunction)apa102_fade_to_black,			METH_VARARGS,					apa102_fade_to_black_doc},
 	{"dump_array",				(PyCFunction)apa102_dump_array,				METH_VARARGS,					apa102_dump_array_doc},
 	{NULL, NULL, 0, NULL}           /* sentinel */
 };
 static PyGetSetDef apa102_getset[] = {
 	{"num_led", 			(getter)apa102_get_num_led,				0,	apa_num_led_var_doc},
 	{"global_brightness",	(getter)apa102_get_global_brightness,	0,	apa_global_brightness_var_doc},
+	{"stats",				(getter)apa102_get_stats,				0,	apa_stats_var_doc},
 	{"order", 				(getter)apa102_get_order,				0,	apa_order_var_doc},
 	{"write_callback",		(getter)apa102_get_write_callback,		0,	apa_write_callback_var_doc},
+	{"fd",					(getter)apa102_get_fd,					0,	apa_fd_var_doc},
+	{"chunk_size",			(getter)apa102_get_chunk_size,			0,	apa_chunk_size_var_doc},
+	{"render_threads",		(getter)apa102_get_render_threads,		0,	apa_render_threads_var_doc},
+	{"gamma",				(getter)apa102_get_gamma,				0,	apa_gamma_var_doc},
+	{"dimmer",				(getter)apa102_get_dimmer,				0,	apa_dimmer_var_doc},
+	{"layer",				(getter)apa102_get_layer,				0,	apa_layer_var_doc},
+	{"layout",				(getter)apa102_get_layout,				0,	apa_layout_var_doc},
+	{"num_layers",			(getter)apa102_get_num_layers,			0,	apa_num_layers_var_doc},
+	{"palette_size",		(getter)apa102_get_palette_size,		0,	apa_palette_size_var_doc},
 	{"MAX_BRIGHTNESS", 		(getter)apa102_get_max_brightness,		0,	apa_max_brightness_var_doc},
 	{NULL},
 };
+static PyMethodDef timeline_methods[] = {
+	{"add_keyframe",			(PyCFunction)timeline_add_keyframe,			METH_VARARGS | METH_KEYWORDS,	timeline_add_keyframe_doc},
+	{"clear",					(PyCFunction)timeline_clear,				METH_NOARGS,					timeline_clear_doc},
+	{"render",					(PyCFunction)timeline_render,				METH_VARARGS | METH_KEYWORDS,	timeline_render_doc},
+	{NULL, NULL, 0, NULL}           /* sentinel */
+};
+static PyGetSetDef timeline_getset[] = {
+	{"duration",			(getter)timeline_get_duration,			0,	timeline_duration_var_doc},
+	{"num_keyframes",		(getter)timeline_get_num_keyframes,		0,	timeline_num_keyframes_var_doc},
+	{"num_led",				(getter)timeline_get_num_led,			0,	timeline_num_led_var_doc},
+	{NULL},
+};
+static PyMethodDef layout_methods[] = {
+	{"index",					(PyCFunction)layout_index,					METH_VARARGS,					layout_index_doc},
+	{NULL, NULL, 0, NULL}           /* sentinel */
+};
+static PyGetSetDef layout_getset[] = {
+	{"width",				(getter)layout_get_width,				0,	layout_width_var_doc},
+	{"height",				(getter)layout_get_height,				0,	layout_height_var_doc},
+	{"num_led",				(getter)layout_get_num_led,				0,	layout_num_led_var_doc},
+	{NULL},
+};
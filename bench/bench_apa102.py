@@ -0,0 +1,232 @@
+#!/usr/bin/env python3
+"""Benchmarks for the apa102 module's hot paths.
+
+Build the module first (python3 setup.py build_ext --inplace, or install it), then run
+	python3 bench/bench_apa102.py [--sizes 10,100,1000] [--min-time 0.2] [--output results.json]
+
+Every result is one JSON object with the benchmark name, strip size, sink,
+ns per call, calls per second, the bytes allocated per call (the tracemalloc peak
+above what was in use before the call, so memory freed before the call returns,
+like the list the legacy_list callback gets, still counts), and memory blocks
+left allocated per call (from sys.getallocatedblocks, to catch leaks).
+The list is written to stdout or to --output, so two runs can be diffed to find regressions.
+"""
+import argparse
+import json
+import os
+import platform
+import sys
+import threading
+import time
+import tracemalloc
+
+import apa102
+
+DEFAULT_SIZES = [10, 100, 1000, 10000, 100000]
+ALLOC_CALLS = 20 #calls traced to find the bytes allocated per call, tracemalloc makes them too slow to time
+
+
+def allocated_per_call(func):
+	"""the most bytes func has allocated at once during a call, over ALLOC_CALLS calls"""
+	tracemalloc.start()
+	try:
+		peak = 0
+		for _ in range(ALLOC_CALLS):
+			before = tracemalloc.get_traced_memory()[0]
+			tracemalloc.reset_peak()
+			func()
+			peak = max(peak, tracemalloc.get_traced_memory()[1] - before)
+	finally:
+		tracemalloc.stop()
+	return peak
+
+
+def measure(func, min_time):
+	"""calls func until min_time seconds have passed, returns (ns per call, calls, bytes allocated per call, blocks left per call)"""
+	#warm up so lazily allocated buffers don't count
+	func()
+	calls = 0
+	batch = 1
+	blocks_before = sys.getallocatedblocks()
+	start = time.perf_counter_ns()
+	while True:
+		for _ in range(batch):
+			func()
+		calls += batch
+		elapsed = time.perf_counter_ns() - start
+		if elapsed >= min_time * 1e9:
+			break
+		batch *= 2
+	blocks = sys.getallocatedblocks() - blocks_before
+	return elapsed / calls, calls, allocated_per_call(func), blocks / calls
+
+
+class PipeSink:
+	"""a pipe with a thread reading everything written to it, so writes never block for long"""
+	def __init__(self):
+		self.read_fd, self.write_fd = os.pipe()
+		self.thread = threading.Thread(target=self.drain, daemon=True)
+		self.thread.start()
+
+	def drain(self):
+		#reads into one buffer so this thread doesn't show up in the bytes allocated per frame
+		buffer = bytearray(1 << 16)
+		while os.readv(self.read_fd, [buffer]):
+			pass
+
+	def close(self):
+		os.close(self.write_fd)
+		self.thread.join()
+		os.close(self.read_fd)
+
+
+def noop(data):
+	pass
+
+
+def make_strip(size, sink, **kwargs):
+	"""returns the strip and a function to clean up after it"""
+	if sink == "callback":
+		return apa102.APA102(size, noop, **kwargs), lambda: None
+	if sink == "legacy_list":
+		return apa102.APA102(size, noop, legacy_list=True, **kwargs), lambda: None
+	if sink == "file":
+		return apa102.APA102(size, os.devnull, **kwargs), lambda: None
+	if sink == "pipe":
+		pipe = PipeSink()
+		strip = apa102.APA102(size, pipe.write_fd, **kwargs)
+		return strip, pipe.close
+	raise ValueError(sink)
+
+
+def pixel_benchmarks(size):
+	"""benchmarks that only touch the pixels, one (name, setup) pair each, setup returns the function to time"""
+	def set_pixel(strip):
+		last = size - 1
+		return lambda: strip.set_pixel(last, 255, 128, 0)
+
+	def set_pixel_rgb(strip):
+		last = size - 1
+		return lambda: strip.set_pixel_rgb(last, 0xFF8000)
+
+	def set_pixel_rgb_keyword(strip):
+		#keywords take the slower PyArg_ParseTupleAndKeywords path
+		last = size - 1
+		return lambda: strip.set_pixel_rgb(last, 0xFF8000, brightness=31)
+
+	def set_range(strip):
+		end = size // 2
+		return lambda: strip.set_range(0, end, 255, 128, 0)
+
+	def set_all(strip):
+		return lambda: strip.set_all(255, 128, 0)
+
+	def rotate(strip):
+		return lambda: strip.rotate(1)
+
+	def get_pixel_color(strip):
+		last = size - 1
+		return lambda: strip.get_pixel_color(last)
+
+	def get_pixel_color_rgb(strip):
+		last = size - 1
+		return lambda: strip.get_pixel_color_rgb(last)
+
+	def set_pixels(strip):
+		data = bytes(range(256)) * (size * 3 // 256 + 1)
+		data = data[:size * 3]
+		return lambda: strip.set_pixels(data)
+
+	return [
+		("set_pixel", set_pixel),
+		("set_pixel_rgb", set_pixel_rgb),
+		("set_pixel_rgb_keyword", set_pixel_rgb_keyword),
+		("set_range", set_range),
+		("set_all", set_all),
+		("rotate", rotate),
+		("get_pixel_color", get_pixel_color),
+		("get_pixel_color_rgb", get_pixel_color_rgb),
+		("set_pixels", set_pixels),
+	]
+
+
+def show_benchmarks(size):
+	"""show() after changing one pixel, after changing every pixel, and with nothing changed"""
+	def one_pixel(strip):
+		state = [0]
+		def frame():
+			state[0] ^= 255
+			strip.set_pixel(0, state[0], 0, 0)
+			strip.show()
+		return frame
+
+	def full_frame(strip):
+		def frame():
+			strip.rotate(1)
+			strip.show()
+		return frame
+
+	def unchanged(strip):
+		return strip.show
+
+	return [
+		("show_one_pixel", one_pixel),
+		("show_full_frame", full_frame),
+		("show_unchanged", unchanged),
+	]
+
+
+def run(sizes, sinks, min_time):
+	results = []
+	for size in sizes:
+		strip, cleanup = make_strip(size, "callback")
+		for name, setup in pixel_benchmarks(size):
+			ns, calls, alloc, blocks = measure(setup(strip), min_time)
+			results.append({"benchmark": name, "num_led": size, "sink": None, "ns_per_op": round(ns, 1),
+				"ops_per_sec": round(1e9 / ns, 1), "calls": calls, "alloc_bytes_per_op": alloc,
+				"leaked_blocks_per_op": round(blocks, 3)})
+		cleanup()
+
+		for sink in sinks:
+			strip, cleanup = make_strip(size, sink)
+			for name, setup in show_benchmarks(size):
+				ns, calls, alloc, blocks = measure(setup(strip), min_time)
+				results.append({"benchmark": name, "num_led": size, "sink": sink, "ns_per_op": round(ns, 1),
+					"frames_per_sec": round(1e9 / ns, 1), "calls": calls, "alloc_bytes_per_frame": alloc,
+					"leaked_blocks_per_frame": round(blocks, 3)})
+			del strip
+			cleanup()
+		print("finished %d leds" % size, file=sys.stderr)
+	return results
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+	parser.add_argument("--sizes", default=",".join(str(size) for size in DEFAULT_SIZES),
+		help="comma separated strip sizes (default %(default)s)")
+	parser.add_argument("--sinks", default="callback,legacy_list,file,pipe",
+		help="where show() sends frames: callback, legacy_list, file, pipe (default %(default)s)")
+	parser.add_argument("--min-time", type=float, default=0.2,
+		help="seconds to run each benchmark for (default %(default)s)")
+	parser.add_argument("--output", help="write the JSON here instead of stdout")
+	args = parser.parse_args()
+
+	sizes = [int(size) for size in args.sizes.split(",") if size]
+	sinks = [sink for sink in args.sinks.split(",") if sink]
+	report = {
+		"python": platform.python_version(),
+		"machine": platform.machine(),
+		"platform": platform.platform(),
+		"min_time": args.min_time,
+		"results": run(sizes, sinks, args.min_time),
+	}
+	text = json.dumps(report, indent=1)
+	if args.output:
+		with open(args.output, "w") as file:
+			file.write(text + "\n")
+	else:
+		print(text)
+
+
+if __name__ == "__main__":
+	main()
@@ -1,7 +1,8 @@
 from distutils.core import setup, Extension
 
 apa102module = Extension('apa102',
-					sources = ['apa102module.c'])
+					sources = ['apa102module.c'],
+					libraries = ['pthread', 'm', 'rt'])
 
 setup (name = 'apa102',
 		version = '1.0',
@@ -0,0 +1,206 @@
+"""Behaviour checks for the apa102 module.
+
+Build the module first, then run from the top of the repository
+	python3 setup.py build_ext --inplace
+	python3 -m unittest discover tests
+"""
+import array
+import os
+import select
+import tempfile
+import threading
+import time
+import unittest
+
+import apa102
+
+RED = 0xFF0000
+GREEN = 0x00FF00
+
+
+def frame_len(num_led):
+	return 4 + num_led*4 + (num_led + 15)//16
+
+
+def red_at(frame, led):
+	"""the red byte of led in a frame sent with the default order"""
+	return frame[4 + led*4 + 3]
+
+
+class ReinitTests(unittest.TestCase):
+	def check_unchanged(self, s):
+		self.assertEqual(s.num_led, 4)
+		self.assertEqual(s.global_brightness, 5)
+		self.assertEqual(s.order, [2, 3, 1])
+		self.assertEqual(len(bytes(s)), 16)
+
+	def test_exported_pixels(self):
+		s = apa102.APA102(4, None, global_brightness=5, order="grb")
+		view = memoryview(s)
+		with self.assertRaises(BufferError):
+			s.__init__(200000, None)
+		view.release()
+		self.check_unchanged(s)
+
+	def test_bad_arguments(self):
+		s = apa102.APA102(4, None, global_brightness=5, order="grb")
+		bad = [
+			((10**6, "/nonexistent/spidev"), OSError),
+			((-1, None), ValueError),
+			((10**6, 2**40), ValueError),
+			((10**6, -3), ValueError),
+			((10**6, object()), TypeError),
+			((10**6, None), {"chunk_size": -5}, ValueError),
+		]
+		for case in bad:
+			args, kwargs, error = case if len(case) == 3 else (case[0], {}, case[1])
+			with self.subTest(args=args, kwargs=kwargs):
+				with self.assertRaises(error):
+					apa102.APA102.__init__(s, *args, **kwargs)
+				self.check_unchanged(s)
+		s.__init__(10, None)
+		self.assertEqual(s.num_led, 10)
+
+	def test_callback_keeping_the_frame(self):
+		kept = []
+		s = apa102.APA102(4, lambda data: kept.append(data[1:]))
+		with self.assertRaises(BufferError):
+			s.show()
+		with self.assertRaises(BufferError):
+			s.__init__(100000, None)
+		del s
+		self.assertEqual(len(bytes(kept[0])), frame_len(4) - 1)
+
+
+class ShowTests(unittest.TestCase):
+	def test_drawing_during_show(self):
+		#a frame bigger than the pipe, so show() is stuck in write() until the frame is read
+		r, w = os.pipe()
+		self.addCleanup(os.close, r)
+		self.addCleanup(os.close, w)
+		s = apa102.APA102(40000, w)
+		n = frame_len(s.num_led)
+
+		def show_draining(before=None):
+			frames = []
+			def drain():
+				if before is not None:
+					before()
+				data = b""
+				#a show() that sends nothing leaves the pipe empty, so give up instead of waiting forever
+				while len(data) < n and select.select([r], [], [], 2)[0]:
+					data += os.read(r, n - len(data))
+				frames.append(data)
+			t = threading.Thread(target=drain)
+			t.start()
+			sent = s.show()
+			t.join()
+			return sent, frames[0]
+
+		s.set_all(1, 1, 1)
+		self.assertTrue(show_draining(lambda: (time.sleep(0.1), s.set_pixel(5, 9, 9, 9)))[0])
+		sent, frame = show_draining()
+		self.assertTrue(sent)
+		self.assertEqual(red_at(frame, 5), 9)
+
+	def test_show_after_show_async(self):
+		sent = []
+		busy = threading.Lock()
+		overlaps = []
+		def write(data):
+			if not busy.acquire(blocking=False):
+				overlaps.append(True)
+				return
+			time.sleep(0.02)
+			sent.append(red_at(bytes(data), 0))
+			busy.release()
+		s = apa102.APA102(4, write)
+		s.set_async_policy("block", 3)
+		for i in range(1, 4):
+			s.set_all(i, 0, 0)
+			s.show_async()
+		s.set_all(9, 0, 0)
+		s.show()
+		s.wait()
+		self.assertEqual(overlaps, [])
+		self.assertEqual(sent, [1, 2, 3, 9])
+
+	def test_unchanged_frame_is_skipped(self):
+		s = apa102.APA102(4, lambda data: None)
+		self.assertTrue(s.show())
+		self.assertFalse(s.show())
+		s.set_pixel(1, 1, 2, 3)
+		self.assertTrue(s.show())
+
+
+class IndexedTests(unittest.TestCase):
+	def test_rotate(self):
+		s = apa102.APA102(4, None)
+		s.set_palette(bytes([0, 255, 0, 255, 0, 0]))
+		s.set_indices(bytes([1, 0, 0, 0]))
+		s.show()
+		s.rotate(1)
+		s.show(force=True)
+		self.assertEqual([s.get_pixel_color_rgb(i) for i in range(4)], [GREEN, GREEN, GREEN, RED])
+		s.rotate(-2)
+		s.show()
+		self.assertEqual([s.get_pixel_color_rgb(i) for i in range(4)], [GREEN, RED, GREEN, GREEN])
+
+
+class RecordTests(unittest.TestCase):
+	def test_round_trip(self):
+		path = os.path.join(tempfile.mkdtemp(), "show.anim")
+		self.addCleanup(os.rmdir, os.path.dirname(path))
+		self.addCleanup(os.remove, path)
+		s = apa102.APA102(50, lambda data: None)
+		s.record(path, fps=1000)
+		frames = []
+		for f in range(20):
+			s.set_pixel(f, f, 2*f, 3*f)
+			if f % 5 == 0:
+				s.rotate(3)
+			if f % 2:
+				s.show()
+			else:
+				s.show_async()
+			frames.append(bytes(s))
+		s.wait()
+		self.assertEqual(s.stop_recording(), 20)
+
+		played = []
+		t = apa102.APA102(50, lambda data: played.append(bytes(data)[4:4 + 50*4]))
+		self.assertEqual(t.play(path, fps=10000), 20)
+		self.assertEqual(played, frames)
+		with self.assertRaises(ValueError):
+			apa102.APA102(10, None).play(path)
+
+
+class ArgumentTests(unittest.TestCase):
+	def test_parse_errors(self):
+		s = apa102.APA102(2, None)
+		with self.assertRaises(TypeError):
+			s.wheel("x")
+		with self.assertRaises(TypeError):
+			s.combine_color(1, "x", 3)
+
+	def test_unaligned_indices(self):
+		s = apa102.APA102(10, None)
+		raw = memoryview(b"\0" + array.array("I", [3, 7]).tobytes())[1:]
+		s.set_pixels_at(raw, bytes([1, 2, 3, 4, 5, 6]))
+		self.assertEqual(s.get_pixels_at(raw), bytes([1, 2, 3, 4, 5, 6]))
+
+	def test_blit_width_from_shape(self):
+		s = apa102.APA102(16, None)
+		s.set_layout(apa102.Layout(4, 4))
+		image = bytes(range(2*3*4))
+		s.blit(memoryview(image).cast("B", (2, 3, 4)), layout="rgba")
+		t = apa102.APA102(16, None)
+		t.set_layout(s.layout)
+		t.blit(image, width=3, layout="rgba")
+		self.assertEqual(bytes(s), bytes(t))
+		with self.assertRaises(ValueError):
+			s.blit(memoryview(image).cast("B", (2, 3, 4)))
+
+
+if __name__ == "__main__":
+	unittest.main()